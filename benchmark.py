@@ -150,6 +150,11 @@ def run_protocol(config, name, print_cmds=True):
         "--hashtable-size",config[name]["hashtable_size"],
     ]
 
+    if "channels" in config[name]:
+        args += [ "--channels", config[name]["channels"] ]
+    if "entry_size" in config[name]:
+        args += [ "--entry-size", config[name]["entry_size"] ]
+
     server = subprocess.Popen(
         [
             "./bin/oprf", "--server",
@@ -157,8 +162,14 @@ def run_protocol(config, name, print_cmds=True):
             "--threads", config[name]["threads"],
         ], stdout = subprocess.PIPE, text=True
     )
+    # emulate a slower link between the two
+    shaping = []
+    for option in [ "bandwidth", "rtt", "jitter" ]:
+        if option in config[name]:
+            shaping += [ f"--{option}", config[name][option] ]
+
     client = subprocess.Popen(
-        [ "./bin/oprf", "--client", ] + args,
+        [ "./bin/oprf", "--client", ] + args + shaping,
         stdout = subprocess.PIPE,
         text=True
     )
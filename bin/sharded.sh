@@ -0,0 +1,32 @@
+#!/bin/bash
+# run the protocol with the server's hashtables split across several local processes
+#
+# usage: ./bin/sharded.sh <shards> <server log> <client log> <overlap>
+#
+# each shard holds every <shards>'th hashtable of the cuckoo table, so <shards>
+# can be at most the cuckoo size (8)
+
+SHARDS=${1:-4}
+SERVER_LOG=${2:-10}
+CLIENT_LOG=${3:-0}
+OVERLAP=${4:-1}
+
+CUCKOO="--cuckoo-size 8 --hashtable-size 512"
+
+rm -r ./out/* 2> /dev/null
+(cd out/; seq 0 1 8 | xargs -n 1 mkdir)
+set -e
+./bin/datagen --server-log $SERVER_LOG --client-log $CLIENT_LOG --overlap $OVERLAP
+
+for SHARD in $(seq 0 1 $((SHARDS - 1))); do
+    ./bin/oprf --server --shard $SHARD --shards $SHARDS $CUCKOO --cuckoo-hashes 2 > /dev/null &
+done
+./bin/oprf --server --shards $SHARDS $CUCKOO --cuckoo-hashes 2 &
+./bin/oprf --client $CUCKOO --cuckoo-hashes 2 &
+wait
+./bin/pir  --client --shards $SHARDS $CUCKOO --buckets-per-col 2 --expected $OVERLAP &
+for SHARD in $(seq 0 1 $((SHARDS - 1))); do
+    ./bin/pir  --server --shard $SHARD --shards $SHARDS $CUCKOO --buckets-per-col 2 --queries-log $CLIENT_LOG > /dev/null &
+done
+wait
+set +e
@@ -4,7 +4,9 @@ import (
 	"crypto/aes"
     "bytes"
     "encoding/binary"
+    "io"
     "net"
+    "os"
 )
 
 const (
@@ -14,7 +16,13 @@ const (
     BLANK_QUERY = ^uint64(0)
 )
 
-func RunClient(psiParams *PSIParams, server net.Conn) int64 {
+/**
+ * run protocol as the client
+ *
+ * @param <servers> connection to each server, by shard (table i is held by
+ *                  servers[i % len(servers)])
+ */
+func RunClient(psiParams *PSIParams, servers []net.Conn) int64 {
 
     // read in query indices
     _, queries := ReadDatabase[uint64, uint64](CLIENT_QUERIES)
@@ -22,16 +30,21 @@ func RunClient(psiParams *PSIParams, server net.Conn) int64 {
     // read in result of oprf
     _, oprf := ReadDatabase[byte, byte](CLIENT_OPRF_RESULT)
 
-    // wait until the server is ready for offline
+    // the oprf may have been run with a non-default entry size
+    entrySize := ENTRY_SIZE
+    if len(queries) > 0 { entrySize = len(oprf) / len(queries) }
+
+    // wait until the servers are ready for offline
     ready := make([]byte, 1)
-    server.Read(ready)
+    for _, server := range servers { server.Read(ready) }
+    serverOf := func(table uint64) net.Conn { return servers[table % uint64(len(servers))] }
 
     /////////////////// OFFLINE ////////////////////
     timer := StartTimer("[ client ] pir offline", YELLOW)
     found := int64(0)
     states := make([]*ClientState, 0)
     if psiParams.CuckooSize == 1 {
-        state := CreateClientState(psiParams, server)
+        state := CreateClientState(psiParams, servers[0], 0)
         // need a copy of the state for each query
         for _ = range queries {
             cpy := *state
@@ -39,7 +52,7 @@ func RunClient(psiParams *PSIParams, server net.Conn) int64 {
         }
     } else {
         for i := uint64(0); i < psiParams.CuckooSize; i++ {
-            states = append(states, CreateClientState(psiParams, server))
+            states = append(states, CreateClientState(psiParams, serverOf(i), i))
         }
     }
     timer.End()
@@ -55,28 +68,35 @@ func RunClient(psiParams *PSIParams, server net.Conn) int64 {
     }
     comp.Stop()
 
-    // let the server know we're ready for online
+    // let the servers know we're ready for online
     ready = []byte{1}
-    server.Write(ready)
+    for _, server := range servers { server.Write(ready) }
 
     network.Start()
-    for _, request := range requests {
-        WriteOverNetwork(server, request)
+    for i, request := range requests {
+        WriteOverNetwork(serverOf(uint64(i)), request)
     }
     network.Stop()
 
+    recovered := make([][]byte, len(states))
     for i, state := range states {
         network.Start()
-        response := ReadOverNetwork(server, ModuloSwitchLength(state.Params.L))
+        response := ReadOverNetwork(serverOf(uint64(i)), ModuloSwitchLength(state.Params.L))
         network.Stop()
         comp.Start()
-        found += state.ReadResponse(response, oprf[i*ENTRY_SIZE:(i+1)*ENTRY_SIZE])
+        recovered[i] = state.RecoverBucket(response)
+        found += CountMatches(recovered[i], oprf[i*entrySize:(i+1)*entrySize])
         comp.Stop()
     }
     comp.End()
     timer.End()
     ////////////////////////////////////////////////
 
+    // let the resolver map the buckets back to the client's items
+    if psiParams.Recovered != "" {
+        WriteRecovered(recovered, psiParams.Recovered)
+    }
+
     return found
 }
 
@@ -96,9 +116,12 @@ type ClientState struct {
 
 
 /**
- * download hint / lwe matrix and compute parameters
+ * download hint / lwe matrix (or what changed since the cached hint) and
+ *  compute parameters
+ *
+ * @param <table> which of the server's hashtables this is for
  */
-func CreateClientState(psiParams *PSIParams, server net.Conn) *ClientState {
+func CreateClientState(psiParams *PSIParams, server net.Conn, table uint64) *ClientState {
     comp := CreateTimer("[ client ] offline comp", YELLOW)
     network := StartTimer("[ client ] offline net", YELLOW)
     // read bucket size from server
@@ -112,19 +135,55 @@ func CreateClientState(psiParams *PSIParams, server net.Conn) *ClientState {
     protocol, params, entryBits := SetupProtocol(psiParams)
     dbInfo := SetupDBInfo(psiParams, entryBits, params)
 
+    // tell the server which version of the hint we already have
+    var hint *Matrix
+    var seed PRGKey
+    cached := HINT_UNVERSIONED
+    if psiParams.HintDir != "" {
+        hint, cached, seed = LoadClientHint(HintDir(psiParams.HintDir, table, psiParams.CuckooSize), params)
+    }
+
     comp.Stop()
     network.Start()
-    // read in the 'offline' data (i.e., lwe matrix seed and hint)
-    offline := ReadOverNetwork(
-        server, aes.BlockSize + ModuloSwitchLength(params.L * params.N),
-    )
+    err = binary.Write(server, binary.LittleEndian, cached)
+    if err != nil { panic(err) }
+    binary.Write(server, binary.LittleEndian, seed[:])
+
+    var version, mode uint64
+    binary.Read(server, binary.LittleEndian, &version)
+    binary.Read(server, binary.LittleEndian, &mode)
+
+    var deltas []HintDelta
+    if mode == HINT_FULL {
+        // read in the 'offline' data (i.e., lwe matrix seed and hint)
+        offline := ReadOverNetwork(
+            server, aes.BlockSize + ModuloSwitchLength(params.L * params.N),
+        )
+        hint = ModuloSwitchBack(offline[aes.BlockSize:], params.L, params.N)
+        copy(seed[:], offline[:aes.BlockSize])
+    } else if mode == HINT_DELTAS {
+        var count uint64
+        binary.Read(server, binary.LittleEndian, &count)
+        for i := uint64(0); i < count; i++ {
+            var rows uint64
+            binary.Read(server, binary.LittleEndian, &rows)
+            delta := HintDelta{ Rows: make([]uint64, rows) }
+            binary.Read(server, binary.LittleEndian, delta.Rows)
+            delta.Data = make([]byte, ModuloSwitchLength(rows * params.N))
+            if _, err := io.ReadFull(server, delta.Data); err != nil { panic(err) }
+            deltas = append(deltas, delta)
+        }
+    }
     network.End()
     comp.Start()
-    hint := ModuloSwitchBack(offline[aes.BlockSize:], params.L, params.N)
+
+    // patch the cached hint in order and keep it for next time
+    for _, delta := range deltas { delta.Apply(hint) }
+    if psiParams.HintDir != "" && version != HINT_UNVERSIONED && mode != HINT_CURRENT {
+        SaveClientHint(HintDir(psiParams.HintDir, table, psiParams.CuckooSize), hint, version, seed)
+    }
 
     // this seeds the randomness when generating the lwe matrix
-    var seed PRGKey
-    copy(seed[:], offline[:aes.BlockSize])
     bufPrgReader = NewBufPRG(NewPRG(&seed))
 
     // generate the lwe matrix from the seed
@@ -174,15 +233,21 @@ func (state* ClientState) ComputeQuery(column uint64) []byte {
  *  process query response and determine intersection
  */
 func (state* ClientState) ReadResponse(response, oprf []byte) int64 {
+    return CountMatches(state.RecoverBucket(response), oprf)
+}
+
+/**
+ *  reconstruct the database column the query asked for (nil for blank queries)
+ */
+func (state* ClientState) RecoverBucket(response []byte) []byte {
 
     // if this is a blank query, don't bother recovering
-    if state.SkipRecover { return 0; }
+    if state.SkipRecover { return nil; }
 
     answer := ModuloSwitchBack(response, state.Params.L, 1)
 
     // reconstruct the data based on the answer
-    var results []byte
-    column := RecoverColumn(
+    return RecoverColumn(
         MakeMsg(state.Hint),
         *state.Query,
         MakeMsg(answer),
@@ -190,22 +255,42 @@ func (state* ClientState) ReadResponse(response, oprf []byte) int64 {
         *state.Params,
         state.DBInfo,
     )
+}
+
+/**
+ *  number of times the oprf result appears in a recovered column
+ */
+func CountMatches(column, oprf []byte) int64 {
 
     // only add non-zero results (i.e., not padding)
-    var PADDING [ENTRY_SIZE]byte
-    for j := 0; j < len(column); j += ENTRY_SIZE {
-        if !bytes.Equal(column[j:j+ENTRY_SIZE], PADDING[:]) {
-            results = append(results, column[j:j+ENTRY_SIZE]...)
+    var results []byte
+    entrySize := len(oprf)
+    PADDING := make([]byte, entrySize)
+    for j := 0; j+entrySize <= len(column); j += entrySize {
+        if !bytes.Equal(column[j:j+entrySize], PADDING) {
+            results = append(results, column[j:j+entrySize]...)
         }
     }
 
     // find intersection between oprf and pir results
     intersection := int64(0)
-    for i := 0; i < len(results); i += ENTRY_SIZE {
-        if bytes.Equal(results[i:i+ENTRY_SIZE], oprf) {
+    for i := 0; i < len(results); i += entrySize {
+        if bytes.Equal(results[i:i+entrySize], oprf) {
             intersection++;
         }
     }
 
     return intersection
 }
+
+/**
+ *  write each recovered column as its length followed by its bytes
+ */
+func WriteRecovered(recovered [][]byte, filename string) {
+    var buffer bytes.Buffer
+    for _, column := range recovered {
+        binary.Write(&buffer, binary.LittleEndian, uint64(len(column)))
+        buffer.Write(column)
+    }
+    if err := os.WriteFile(filename, buffer.Bytes(), 0644); err != nil { panic(err) }
+}
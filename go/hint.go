@@ -0,0 +1,351 @@
+package main
+
+import (
+    "bytes"
+    "encoding/binary"
+    "fmt"
+    "net"
+    "os"
+    "path/filepath"
+    "sort"
+)
+
+const (
+    // files kept in the server's hint store
+    HINT_STORE_STATE = "hint.state"
+    HINT_STORE_DATA  = "hint.db"
+    HINT_STORE_DELTA = "hint.%d.delta"
+
+    // file the client keeps its hint in
+    HINT_CACHE_FILE = "hint.cache"
+
+    // version of a hint that isn't kept between runs
+    HINT_UNVERSIONED = uint64(0)
+
+    // what the server sends after the hint's version
+    HINT_CURRENT = uint64(0) // the client's cached hint is up to date
+    HINT_DELTAS  = uint64(1) // the rows that changed since the client's version
+    HINT_FULL    = uint64(2) // the lwe matrix seed and the whole hint
+)
+
+/**
+ * the server's hint for one database kept between runs, so when the database
+ *  changes only the rows of the hint it touches are recomputed and sent
+ */
+type HintStore struct {
+    Dir        string
+    Version    uint64   // bumped each time the hint changes
+    Base       uint64   // oldest version the stored deltas apply to
+    Seed       PRGKey   // seed of the lwe matrix the hint was computed with
+    L, M, N, P uint64   // dims the hint was computed with
+    BucketSize uint64
+    Hint       *Matrix  // L x N at full precision
+    Data       []uint64 // the database bytes the hint was computed from
+}
+
+/**
+ * the rows of the hint that changed to reach <Version>, modulo switched
+ *  like the full hint
+ */
+type HintDelta struct {
+    Version uint64
+    Rows    []uint64
+    Data    []byte
+}
+
+/**
+ * read the hint store in <dir>, or nil if there isn't one
+ */
+func LoadHintStore(dir string) *HintStore {
+    state, err := os.ReadFile(filepath.Join(dir, HINT_STORE_STATE))
+    if err != nil { return nil }
+    data, err := os.ReadFile(filepath.Join(dir, HINT_STORE_DATA))
+    if err != nil { return nil }
+
+    store := &HintStore{ Dir: dir }
+    reader := bytes.NewReader(state)
+    header := []*uint64{
+        &store.Version, &store.Base, &store.L, &store.M, &store.N, &store.P, &store.BucketSize,
+    }
+    for _, field := range header {
+        if binary.Read(reader, binary.LittleEndian, field) != nil { return nil }
+    }
+    if _, err := reader.Read(store.Seed[:]); err != nil { return nil }
+
+    hint := make([]byte, store.L * store.N * ELEMENT_SIZE)
+    if n, _ := reader.Read(hint); n != len(hint) { return nil }
+    store.Hint = BytesToMatrix(hint, store.L, store.N)
+
+    store.Data = make([]uint64, len(data))
+    for i := range data { store.Data[i] = uint64(data[i]) }
+    return store
+}
+
+/**
+ * write the hint and the database it was computed from to the store
+ */
+func (store *HintStore) Save() {
+    if err := os.MkdirAll(store.Dir, 0755); err != nil { panic(err) }
+
+    var state bytes.Buffer
+    header := []uint64{
+        store.Version, store.Base, store.L, store.M, store.N, store.P, store.BucketSize,
+    }
+    binary.Write(&state, binary.LittleEndian, header)
+    state.Write(store.Seed[:])
+    state.Write(MatrixToBytes(store.Hint))
+
+    data := make([]byte, len(store.Data))
+    for i := range store.Data { data[i] = byte(store.Data[i]) }
+
+    if err := os.WriteFile(filepath.Join(store.Dir, HINT_STORE_STATE), state.Bytes(), 0644); err != nil { panic(err) }
+    if err := os.WriteFile(filepath.Join(store.Dir, HINT_STORE_DATA), data, 0644); err != nil { panic(err) }
+}
+
+/**
+ * keep the rows that changed to reach the store's current version
+ */
+func (store *HintStore) SaveDelta(delta HintDelta) {
+    var buffer bytes.Buffer
+    binary.Write(&buffer, binary.LittleEndian, uint64(len(delta.Rows)))
+    binary.Write(&buffer, binary.LittleEndian, delta.Rows)
+    buffer.Write(delta.Data)
+
+    filename := filepath.Join(store.Dir, fmt.Sprintf(HINT_STORE_DELTA, delta.Version))
+    if err := os.WriteFile(filename, buffer.Bytes(), 0644); err != nil { panic(err) }
+}
+
+/**
+ * the deltas taking a hint from version <since> to the current one, or nil
+ *  if they aren't all stored or together are no smaller than <limit> bytes
+ */
+func (store *HintStore) Deltas(since, limit uint64) []HintDelta {
+    if since == HINT_UNVERSIONED || since < store.Base || since >= store.Version {
+        return nil
+    }
+
+    var deltas []HintDelta
+    total := uint64(0)
+    for version := since + 1; version <= store.Version; version++ {
+        filename := filepath.Join(store.Dir, fmt.Sprintf(HINT_STORE_DELTA, version))
+        contents, err := os.ReadFile(filename)
+        if err != nil { return nil }
+
+        reader := bytes.NewReader(contents)
+        var count uint64
+        if binary.Read(reader, binary.LittleEndian, &count) != nil { return nil }
+        rows := make([]uint64, count)
+        if binary.Read(reader, binary.LittleEndian, rows) != nil { return nil }
+        data := contents[len(contents) - reader.Len():]
+
+        total += uint64(len(contents))
+        if total >= limit { return nil }
+        deltas = append(deltas, HintDelta{ Version: version, Rows: rows, Data: data })
+    }
+    return deltas
+}
+
+/**
+ * whether the stored hint was computed for a database with these params
+ */
+func (store *HintStore) Matches(params *Params, bucketSize uint64, dataset []uint64) bool {
+    return store.L == params.L && store.M == params.M && store.N == params.N &&
+        store.P == params.P && store.BucketSize == bucketSize &&
+        uint64(len(store.Data)) == uint64(len(dataset))
+}
+
+/**
+ * bring hint = DB * A from the database <old> to <updated> in place, with
+ *  the database entries laid out in Z_p elements stacked into columns of
+ *  <rows> as CreateDatabase does for <info>, so a changed entry only
+ *  changes the row of the hint its elements sit in
+ *
+ * @return the rows of the hint that changed, in order
+ */
+func UpdateHint(hint, A *Matrix, old, updated []uint64, info DBinfo, rows uint64) []uint64 {
+    changed := make(map[uint64]bool)
+    for i := range updated {
+        if old[i] == updated[i] { continue }
+
+        // the p/2 shift of both elements cancels out
+        if info.Packing > 0 {
+            // entry i is a digit (in base 2^Row_length) of element i / Packing
+            at := uint64(i) / info.Packing
+            coeff := uint64(1) << (info.Row_length * (uint64(i) % info.Packing))
+            row, col := at % rows, at / rows
+            hint.AddScaledRow(row, (updated[i] - old[i]) * coeff, A, col)
+            changed[row] = true
+        } else {
+            // entry i is spread over Ne elements side by side in its row
+            row := uint64(i) % rows
+            for j := uint64(0); j < info.Ne; j++ {
+                scale := Base_p(info.P, updated[i], j) - Base_p(info.P, old[i], j)
+                if scale == 0 { continue }
+                hint.AddScaledRow(row, scale, A, (uint64(i) / rows) * info.Ne + j)
+                changed[row] = true
+            }
+        }
+    }
+
+    result := make([]uint64, 0, len(changed))
+    for row := range changed { result = append(result, row) }
+    sort.Slice(result, func(i, j int) bool { return result[i] < result[j] })
+    return result
+}
+
+/**
+ * the delta replacing <rows> of the hint with their current values
+ */
+func MakeHintDelta(hint *Matrix, rows []uint64, version uint64) HintDelta {
+    selected := MatrixNew(uint64(len(rows)), hint.Cols)
+    for i, row := range rows {
+        copy(selected.Data[uint64(i) * hint.Cols:], hint.Data[row * hint.Cols:(row + 1) * hint.Cols])
+    }
+    return HintDelta{ Version: version, Rows: rows, Data: ModuloSwitch(selected) }
+}
+
+/**
+ * replace the rows of a (modulo switched back) hint the delta changed
+ */
+func (delta HintDelta) Apply(hint *Matrix) {
+    values := ModuloSwitchBack(delta.Data, uint64(len(delta.Rows)), hint.Cols)
+    for i, row := range delta.Rows {
+        copy(hint.Data[row * hint.Cols:(row + 1) * hint.Cols], values.Data[uint64(i) * hint.Cols:])
+    }
+}
+
+/**
+ * number of bytes that changed from <old> to <updated> outside <positions>,
+ *  which should be none when <positions> come from the last update
+ */
+func UnlistedChanges(old, updated []uint64, positions []uint64) uint64 {
+    listed := make(map[uint64]bool, len(positions))
+    for _, i := range positions { listed[i] = true }
+
+    unlisted := uint64(0)
+    for i := range updated {
+        if old[i] != updated[i] && !listed[uint64(i)] { unlisted++ }
+    }
+    return unlisted
+}
+
+/**
+ * byte positions of the given buckets in a table of <bucketSize> byte buckets
+ */
+func BucketPositions(buckets []uint64, bucketSize uint64) []uint64 {
+    positions := make([]uint64, 0, uint64(len(buckets)) * bucketSize)
+    for _, bucket := range buckets {
+        for i := uint64(0); i < bucketSize; i++ {
+            positions = append(positions, bucket * bucketSize + i)
+        }
+    }
+    return positions
+}
+
+/**
+ * read the buckets of hashtable <table> an update changed from the file
+ *  the oprf server writes, or nil if the table widened (so every bucket
+ *  moved) or the file doesn't cover it
+ */
+func ReadDirtyBuckets(filename string, table uint64) []uint64 {
+    contents, err := os.ReadFile(filename)
+    if err != nil { panic(err) }
+
+    reader := bytes.NewReader(contents)
+    var tables uint64
+    binary.Read(reader, binary.LittleEndian, &tables)
+    for i := uint64(0); i < tables; i++ {
+        var widened, count uint64
+        binary.Read(reader, binary.LittleEndian, &widened)
+        binary.Read(reader, binary.LittleEndian, &count)
+        buckets := make([]uint64, count)
+        if binary.Read(reader, binary.LittleEndian, buckets) != nil { return nil }
+
+        if i == table {
+            if widened != 0 { return nil }
+            return buckets
+        }
+    }
+    return nil
+}
+
+/**
+ * send the client whatever it needs to bring its cached hint (of version
+ *  <cached>, computed with the lwe matrix from <seed>) up to date
+ *
+ * @return number of bytes sent
+ */
+func (state *ServerState) WriteHint(conn net.Conn, cached uint64, seed PRGKey) int {
+    // versions only line up within a store, i.e. for the same lwe matrix
+    if state.Store == nil || seed != state.Store.Seed { cached = HINT_UNVERSIONED }
+
+    binary.Write(conn, binary.LittleEndian, state.Version)
+    if state.Version != HINT_UNVERSIONED && cached == state.Version {
+        binary.Write(conn, binary.LittleEndian, HINT_CURRENT)
+        return 2 * UINT64_SIZE
+    }
+
+    var deltas []HintDelta
+    if state.Store != nil {
+        deltas = state.Store.Deltas(cached, uint64(len(state.Offline)))
+    }
+    if deltas == nil {
+        binary.Write(conn, binary.LittleEndian, HINT_FULL)
+        WriteOverNetwork(conn, state.Offline)
+        return 2 * UINT64_SIZE + len(state.Offline)
+    }
+
+    binary.Write(conn, binary.LittleEndian, HINT_DELTAS)
+    binary.Write(conn, binary.LittleEndian, uint64(len(deltas)))
+    sent := 3 * UINT64_SIZE
+    for _, delta := range deltas {
+        binary.Write(conn, binary.LittleEndian, uint64(len(delta.Rows)))
+        binary.Write(conn, binary.LittleEndian, delta.Rows)
+        WriteOverNetwork(conn, delta.Data)
+        sent += UINT64_SIZE * (1 + len(delta.Rows)) + len(delta.Data)
+    }
+    return sent
+}
+
+/**
+ * the hint the client cached in <dir> (nil if there isn't one for a hint
+ *  of these dims) and its version and lwe matrix seed
+ */
+func LoadClientHint(dir string, params *Params) (*Matrix, uint64, PRGKey) {
+    var seed PRGKey
+    contents, err := os.ReadFile(filepath.Join(dir, HINT_CACHE_FILE))
+    if err != nil { return nil, HINT_UNVERSIONED, seed }
+
+    reader := bytes.NewReader(contents)
+    var version, rows, cols uint64
+    binary.Read(reader, binary.LittleEndian, &version)
+    binary.Read(reader, binary.LittleEndian, &rows)
+    binary.Read(reader, binary.LittleEndian, &cols)
+    reader.Read(seed[:])
+    if rows != params.L || cols != params.N || uint64(reader.Len()) != rows * cols * ELEMENT_SIZE {
+        return nil, HINT_UNVERSIONED, seed
+    }
+    return BytesToMatrix(contents[len(contents) - reader.Len():], rows, cols), version, seed
+}
+
+/**
+ * cache the client's hint in <dir> for the next run
+ */
+func SaveClientHint(dir string, hint *Matrix, version uint64, seed PRGKey) {
+    if err := os.MkdirAll(dir, 0755); err != nil { panic(err) }
+
+    var buffer bytes.Buffer
+    binary.Write(&buffer, binary.LittleEndian, []uint64{ version, hint.Rows, hint.Cols })
+    buffer.Write(seed[:])
+    buffer.Write(MatrixToBytes(hint))
+    if err := os.WriteFile(filepath.Join(dir, HINT_CACHE_FILE), buffer.Bytes(), 0644); err != nil { panic(err) }
+}
+
+/**
+ * directory of hashtable <table>'s hint within <dir> (tables of a cuckoo
+ *  table each get their own)
+ */
+func HintDir(dir string, table, cuckooSize uint64) string {
+    if cuckooSize == 1 { return dir }
+    return filepath.Join(dir, fmt.Sprint(table))
+}
@@ -0,0 +1,164 @@
+package main
+
+import (
+    "math/rand"
+    "testing"
+)
+
+func hintTestDatabase(params *Params, values []uint64) *Matrix {
+    db := CreateDatabase(8, params, values)
+    return db.Data
+}
+
+func TestUpdateHint(t *testing.T) {
+    params := &Params{ N: 8, L: 16, M: 10, Logq: 32, P: 512 }
+    A := MatrixRand(params.M, params.N, 32, 0)
+
+    old := make([]uint64, params.L * params.M)
+    for i := range old { old[i] = uint64(rand.Intn(256)) }
+
+    // change two buckets of 4 bytes, one byte of which is left as it was
+    bucketSize := uint64(4)
+    buckets := []uint64{ 5, 33 }
+    updated := append([]uint64{}, old...)
+    for _, position := range BucketPositions(buckets, bucketSize)[1:] {
+        updated[position] = (updated[position] + 1 + uint64(rand.Intn(255))) % 256
+    }
+
+    expected := MatrixMul(hintTestDatabase(params, updated), A)
+    hint := MatrixMul(hintTestDatabase(params, old), A)
+    rows := UpdateHint(hint, A, old, updated, SetupDB(uint64(len(old)), 8, params).Info, params.L)
+
+    for i := range expected.Data {
+        if expected.Data[i] != hint.Data[i] {
+            t.Errorf("updated hint differs at %d: %d vs. %d\n", i, hint.Data[i], expected.Data[i])
+            break
+        }
+    }
+
+    // byte i sits in row i % L
+    want := []uint64{ 4, 5, 6, 7 }
+    if len(rows) != len(want) {
+        t.Fatalf("expected rows %v to change, found %v\n", want, rows)
+    }
+    for i := range want {
+        if rows[i] != want[i] { t.Errorf("expected rows %v to change, found %v\n", want, rows) }
+    }
+
+    // a list of buckets missing one of them is caught
+    if unlisted := UnlistedChanges(old, updated, BucketPositions(buckets, bucketSize)); unlisted != 0 {
+        t.Errorf("found %d changed bytes outside the changed buckets\n", unlisted)
+    }
+    if unlisted := UnlistedChanges(old, updated, BucketPositions(buckets[:1], bucketSize)); unlisted != bucketSize {
+        t.Errorf("found %d changed bytes outside the first bucket instead of %d\n", unlisted, bucketSize)
+    }
+}
+
+func TestUpdateHintLayouts(t *testing.T) {
+    // p under 2^8 spreads a byte over elements, up to 2^16 holds one byte
+    //  per element, and past that packs several into each
+    for _, p := range []uint64{ 16, 512, 1 << 17 } {
+        params := &Params{ N: 8, L: 16, M: 12, Logq: 32, P: p }
+        A := MatrixRand(params.M, params.N, 32, 0)
+
+        _, ne, packing := Num_DB_entries(1, 8, p)
+        count := params.L * params.M / ne
+        if packing > 0 { count = params.L * params.M * packing }
+
+        old := make([]uint64, count)
+        for i := range old { old[i] = uint64(rand.Intn(256)) }
+        updated := append([]uint64{}, old...)
+        for _, i := range []int{ 0, 7, int(count) / 2, int(count) - 1 } {
+            updated[i] = (updated[i] + 1 + uint64(rand.Intn(255))) % 256
+        }
+
+        info := SetupDB(count, 8, params).Info
+        expected := MatrixMul(hintTestDatabase(params, updated), A)
+        hint := MatrixMul(hintTestDatabase(params, old), A)
+        rows := UpdateHint(hint, A, old, updated, info, params.L)
+
+        for i := range expected.Data {
+            if expected.Data[i] != hint.Data[i] {
+                t.Errorf("p = %d: updated hint differs from a fresh one at %d\n", p, i)
+                break
+            }
+        }
+
+        // the rows that changed are exactly the ones that differ
+        before := MatrixMul(hintTestDatabase(params, old), A)
+        differ := []uint64{}
+        for row := uint64(0); row < params.L; row++ {
+            for j := uint64(0); j < params.N; j++ {
+                if before.Get(row, j) != expected.Get(row, j) { differ = append(differ, row); break }
+            }
+        }
+        if len(rows) != len(differ) {
+            t.Fatalf("p = %d: expected rows %v to change, found %v\n", p, differ, rows)
+        }
+        for i := range differ {
+            if rows[i] != differ[i] { t.Errorf("p = %d: expected rows %v to change, found %v\n", p, differ, rows) }
+        }
+    }
+}
+
+func TestHintDeltaApply(t *testing.T) {
+    full := FasterMatrixRand(32, 24)
+    rows := []uint64{ 0, 7, 31 }
+
+    // the client's copy before and after the rows change
+    hint := ModuloSwitchBack(ModuloSwitch(full), full.Rows, full.Cols)
+    for _, row := range rows {
+        for j := uint64(0); j < full.Cols; j++ { full.Set(uint64(rand.Uint32()), row, j) }
+    }
+    MakeHintDelta(full, rows, 2).Apply(hint)
+
+    for i := uint64(0); i < full.Rows; i++ {
+        for j := uint64(0); j < full.Cols; j++ {
+            expected := uint32(full.Get(i, j)) >> (32 - MOD_SWITCH_BITS)
+            actual := uint32(hint.Get(i, j)) >> (32 - MOD_SWITCH_BITS)
+
+            // modulo switching rounds either way
+            if actual != expected && actual != expected + 1 && !(expected + 1 == 1 << MOD_SWITCH_BITS && actual == 0) {
+                t.Fatalf("patched hint differs at (%d, %d): %d vs. %d\n", i, j, actual, expected)
+            }
+        }
+    }
+}
+
+func TestHintStore(t *testing.T) {
+    store := &HintStore{
+        Dir: t.TempDir(),
+        Version: 3,
+        Base: 2,
+        L: 16, M: 10, N: 8, P: 512,
+        BucketSize: 4,
+        Hint: MatrixRand(16, 8, 32, 0),
+        Data: make([]uint64, 160),
+    }
+    copy(store.Seed[:], "0123456789abcdef")
+    for i := range store.Data { store.Data[i] = uint64(i % 256) }
+    store.Save()
+    store.SaveDelta(MakeHintDelta(store.Hint, []uint64{ 1, 4 }, 3))
+
+    loaded := LoadHintStore(store.Dir)
+    if loaded == nil {
+        t.Fatalf("couldn't load the hint store\n")
+    }
+    if loaded.Version != 3 || loaded.Base != 2 || loaded.Seed != store.Seed || !loaded.Matches(
+        &Params{ L: 16, M: 10, N: 8, P: 512 }, 4, store.Data,
+    ) {
+        t.Errorf("hint store header changed through the file\n")
+    }
+    for i := range store.Hint.Data {
+        if loaded.Hint.Data[i] != store.Hint.Data[i] { t.Fatalf("hint changed through the file\n") }
+    }
+
+    // a delta is only available from versions the store still covers
+    deltas := loaded.Deltas(2, 1 << 20)
+    if len(deltas) != 1 || len(deltas[0].Rows) != 2 || deltas[0].Rows[1] != 4 {
+        t.Errorf("couldn't read back the stored delta: %v\n", deltas)
+    }
+    if loaded.Deltas(1, 1 << 20) != nil || loaded.Deltas(3, 1 << 20) != nil || loaded.Deltas(2, 8) != nil {
+        t.Errorf("offered deltas that don't apply\n")
+    }
+}
@@ -1,6 +1,7 @@
 package main
 
 import (
+    "encoding/binary"
     "flag"
     "fmt"
     "io/ioutil"
@@ -19,18 +20,24 @@ func main() {
     bucketsPerCol := flag.Int64("buckets-per-col", -1, "number of buckets in a col of the database")
     threads       := flag.Uint("threads", 1, "number of threads to run at once")
     cuckooSize    := flag.Int64("cuckoo-size", 1, "total number of buckets in server's hash table")
+    shards        := flag.Int64("shards", 1, "number of servers the cuckoo table's hashtables are split between")
 
     // optional lwe options
     lweN     := flag.Int64("lwe-n", -1, "lwe secret dimension")
     lweSigma := flag.Float64("lwe-sigma", -1, "lwe error distribution std dev")
     modulus  := flag.Int64("mod", -1, "lwe plaintext modulus")
 
+    hintDir := flag.String("hint-dir", "", "directory to keep the hint in between runs")
+
     // client-only flag
     expected := flag.Int64("expected", -1, "expected size of intersection")
+    recovered := flag.String("recovered", "", "file to write the recovered columns to")
 
     // server-only flag
+    shard       := flag.Int64("shard", 0, "which of the --shards servers this is, holding every --shards'th hashtable")
     queries_log := flag.Int64("queries-log", -1, "log of the number of pir queries")
     queries     := flag.Int64("queries", -1, "the number of pir queries")
+    hintDelta   := flag.String("hint-delta", "", "buckets changed by the last server update, to check the hint comparison against")
 
     debug := flag.Bool("debug", false, "print slightly more robust output")
 
@@ -45,6 +52,9 @@ func main() {
 
     if *hashtableSize == -1 { fmt.Println("expected --hashtable-size argument"); os.Exit(1) }
     if *bucketsPerCol == -1 { fmt.Println("expected --bucket-per-col argument"); os.Exit(1) }
+    if *shards < 1 || *shard < 0 || *shard >= *shards || (*shards > 1 && *shards > *cuckooSize) {
+        fmt.Println("need 0 <= --shard < --shards <= --cuckoo-size"); os.Exit(1)
+    }
 
     psiParams := PSIParams{
         CuckooSize: uint64(*cuckooSize),
@@ -55,6 +65,11 @@ func main() {
         LweN: *lweN,
         LweSigma: *lweSigma,
         Modulus: *modulus,
+        Recovered: *recovered,
+        HintDir: *hintDir,
+        HintDelta: *hintDelta,
+        Shard: uint64(*shard),
+        Shards: uint64(*shards),
     }
 
     // limit the number of threads
@@ -63,17 +78,26 @@ func main() {
     if *client {
         if *expected == -1 { fmt.Println("need --expected argument"); os.Exit(1) }
 
-        // connect to server
+        // connect to every server, which each say which shard they are
         connection, err := net.Listen(SERVER_TYPE, SERVER_HOST)
         if err != nil { panic(err) }
         defer connection.Close()
 
-        server, err := connection.Accept()
-        if err != nil { panic(err) }
-        server.SetDeadline(time.Time{})
+        servers := make([]net.Conn, *shards)
+        for i := int64(0); i < *shards; i++ {
+            server, err := connection.Accept()
+            if err != nil { panic(err) }
+            server.SetDeadline(time.Time{})
+            defer server.Close()
+
+            var index uint64
+            if err := binary.Read(server, binary.LittleEndian, &index); err != nil { panic(err) }
+            if index >= uint64(*shards) || servers[index] != nil { panic("unexpected shard " + fmt.Sprint(index)) }
+            servers[index] = server
+        }
 
         // run protocol
-        actual := RunClient(&psiParams, server)
+        actual := RunClient(&psiParams, servers)
 
         // report results
         if actual == *expected {
@@ -97,6 +121,7 @@ func main() {
             time.Sleep((2 << i) * time.Millisecond)
         }
         defer client.Close()
+        if err := binary.Write(client, binary.LittleEndian, uint64(*shard)); err != nil { panic(err) }
 
         if *queries_log != -1 {
             *queries = 1 << *queries_log
@@ -131,6 +131,19 @@ func (a *Matrix) AddAt(val, i, j uint64) {
 	a.Set(a.Get(i, j) + val, i, j)
 }
 
+// Adds scale times row <bRow> of b to row <row> of a.
+func (a *Matrix) AddScaledRow(row uint64, scale uint64, b *Matrix, bRow uint64) {
+	if a.Cols != b.Cols {
+		panic("Dimension mismatch")
+	}
+	out := a.Data[row*a.Cols : (row+1)*a.Cols]
+	in := b.Data[bRow*b.Cols : (bRow+1)*b.Cols]
+	factor := C.Elem(scale)
+	for j := range out {
+		out[j] += factor * in[j]
+	}
+}
+
 func (a *Matrix) MatrixSub(b *Matrix) {
 	if (a.Cols != b.Cols) || (a.Rows != b.Rows) {
 		fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Rows, b.Cols)
@@ -202,6 +215,40 @@ func MultiMatrixMul(a *Matrix, b *Matrix) *Matrix {
 	return out
 }
 
+// MatrixMul in cache-sized tiles (see matMulTiled), with the rows of a split
+// across up to <threads> goroutines.
+func MatrixMulTiled(a *Matrix, b *Matrix, threads uint) *Matrix {
+	if b.Cols == 1 {
+		return MatrixMulVec(a, b)
+	}
+	if a.Cols != b.Rows {
+		fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Rows, b.Cols)
+		panic("Dimension mismatch")
+	}
+
+	out := MatrixZeros(a.Rows, b.Cols)
+	bounds := RowPartitions(a.Rows, threads)
+
+	var waitGroup sync.WaitGroup
+	for i := 0; i+1 < len(bounds); i++ {
+		waitGroup.Add(1)
+		go func(start, end uint64) {
+			defer waitGroup.Done()
+			C.matMulTiled(
+				(*C.Elem)(&out.Data[start*b.Cols]),
+				(*C.Elem)(&a.Data[start*a.Cols]),
+				(*C.Elem)(&b.Data[0]),
+				C.size_t(end-start),
+				C.size_t(a.Cols),
+				C.size_t(b.Cols),
+			)
+		}(bounds[i], bounds[i+1])
+	}
+	waitGroup.Wait()
+
+	return out
+}
+
 func MatrixMulTransposedPacked(a *Matrix, b *Matrix, basis, compression uint64) *Matrix {
         fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Cols, b.Rows)
         if compression != 3 && basis != 10 {
@@ -245,7 +292,87 @@ func MatrixMulVec(a *Matrix, b *Matrix) *Matrix {
 	return out
 }
 
+// Kernels MatrixMulVecPackedWith can be asked to use.
+const (
+	PACKED_KERNEL_SCALAR = int(C.PACKED_KERNEL_SCALAR)
+	PACKED_KERNEL_AVX2   = int(C.PACKED_KERNEL_AVX2)
+	PACKED_KERNEL_AVX512 = int(C.PACKED_KERNEL_AVX512)
+)
+
+// Whether this CPU can run the given packed kernel.
+func PackedKernelSupported(kernel int) bool {
+	return C.packedKernelSupported(C.int(kernel)) != 0
+}
+
 func MatrixMulVecPacked(a *Matrix, b *Matrix, basis, compression uint64) *Matrix {
+	return MatrixMulVecPackedWith(a, b, basis, compression, int(C.packedKernel()))
+}
+
+// Rows each thread's share of an answer is a multiple of, so no two threads
+// write to the same cache line of the output (16 Elems = 64 bytes) and the
+// scalar kernel's blocks of 8 rows never cross into another share.
+const ROW_PARTITION_ALIGN = 16
+
+// Splits rows into at most threads contiguous ranges, returned as their
+// boundaries (so range i is [bounds[i], bounds[i+1])).
+func RowPartitions(rows uint64, threads uint) []uint64 {
+	if threads < 1 {
+		threads = 1
+	}
+	share := (rows + uint64(threads) - 1) / uint64(threads)
+	share = (share + ROW_PARTITION_ALIGN - 1) / ROW_PARTITION_ALIGN * ROW_PARTITION_ALIGN
+
+	bounds := []uint64{0}
+	for start := share; start < rows; start += share {
+		bounds = append(bounds, start)
+	}
+	return append(bounds, rows)
+}
+
+// Same as MatrixMulVecPacked, with the database rows split across threads.
+// Each thread streams its own contiguous slice of the database and writes its
+// own slice of the output.
+func MatrixMulVecPackedParallel(a *Matrix, b *Matrix, basis, compression uint64, threads uint) *Matrix {
+	if threads <= 1 {
+		return MatrixMulVecPacked(a, b, basis, compression)
+	}
+	if a.Cols*compression != b.Rows {
+		fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Rows, b.Cols)
+		panic("Dimension mismatch")
+	}
+	if b.Cols != 1 {
+		panic("Second argument is not a vector")
+	}
+	if compression != 3 && basis != 10 {
+		panic("Must use hard-coded values!")
+	}
+
+	out := MatrixNew(a.Rows+8, 1)
+	kernel := C.packedKernel()
+	bounds := RowPartitions(a.Rows, threads)
+
+	var waitGroup sync.WaitGroup
+	for i := 0; i+1 < len(bounds); i++ {
+		waitGroup.Add(1)
+		go func(start, end uint64) {
+			defer waitGroup.Done()
+			C.matMulVecPackedWith(
+				kernel,
+				(*C.Elem)(&out.Data[start]),
+				(*C.Elem)(&a.Data[start*a.Cols]),
+				(*C.Elem)(&b.Data[0]),
+				C.size_t(end-start),
+				C.size_t(a.Cols),
+			)
+		}(bounds[i], bounds[i+1])
+	}
+	waitGroup.Wait()
+	out.DropLastRows(8)
+
+	return out
+}
+
+func MatrixMulVecPackedWith(a *Matrix, b *Matrix, basis, compression uint64, kernel int) *Matrix {
 	if a.Cols*compression != b.Rows {
 		fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Rows, b.Cols)
 		panic("Dimension mismatch")
@@ -263,12 +390,46 @@ func MatrixMulVecPacked(a *Matrix, b *Matrix, basis, compression uint64) *Matrix
 	aPtr := (*C.Elem)(&a.Data[0])
 	bPtr := (*C.Elem)(&b.Data[0])
 
-	C.matMulVecPacked(outPtr, aPtr, bPtr, C.size_t(a.Rows), C.size_t(a.Cols))
+	C.matMulVecPackedWith(C.int(kernel), outPtr, aPtr, bPtr, C.size_t(a.Rows), C.size_t(a.Cols))
 	out.DropLastRows(8)
 
 	return out
 }
 
+// Multiplies a packed database by a batch of query vectors stacked as the
+// columns of b, in one pass over a split by rows across threads.
+func MatrixMulPacked(a *Matrix, b *Matrix, basis, compression uint64, threads uint) *Matrix {
+	if a.Cols*compression != b.Rows {
+		fmt.Printf("%d-by-%d vs. %d-by-%d\n", a.Rows, a.Cols, b.Rows, b.Cols)
+		panic("Dimension mismatch")
+	}
+	if compression != 3 && basis != 10 {
+		panic("Must use hard-coded values!")
+	}
+
+	out := MatrixZeros(a.Rows, b.Cols)
+	bounds := RowPartitions(a.Rows, threads)
+
+	var waitGroup sync.WaitGroup
+	for i := 0; i+1 < len(bounds); i++ {
+		waitGroup.Add(1)
+		go func(start, end uint64) {
+			defer waitGroup.Done()
+			C.matMulPacked(
+				(*C.Elem)(&out.Data[start*b.Cols]),
+				(*C.Elem)(&a.Data[start*a.Cols]),
+				(*C.Elem)(&b.Data[0]),
+				C.size_t(end-start),
+				C.size_t(a.Cols),
+				C.size_t(b.Cols),
+			)
+		}(bounds[i], bounds[i+1])
+	}
+	waitGroup.Wait()
+
+	return out
+}
+
 func (m *Matrix) Transpose() {
 	if m.Cols == 1 {
 		m.Cols = m.Rows
@@ -0,0 +1,138 @@
+package main
+
+import (
+    "fmt"
+    "testing"
+)
+
+func TestMatrixMulVecPackedKernels(t *testing.T) {
+    // rows stay a multiple of 8 for the scalar kernel, columns exercise the tails
+    for _, dims := range [][2]uint64{ {8, 3}, {16, 17}, {64, 100}, {256, 1027} } {
+        rows, cols := dims[0], dims[1]
+        a := MatrixRand(rows, cols, 30, 0)
+        b := MatrixRand(cols*3, 1, 32, 0)
+
+        expected := MatrixMulVecPackedWith(a, b, 10, 3, PACKED_KERNEL_SCALAR)
+        for _, kernel := range []int{ PACKED_KERNEL_AVX2, PACKED_KERNEL_AVX512 } {
+            if !PackedKernelSupported(kernel) { continue }
+
+            actual := MatrixMulVecPackedWith(a, b, 10, 3, kernel)
+            for i := range expected.Data {
+                if expected.Data[i] != actual.Data[i] {
+                    t.Errorf(
+                        "kernel %d differs at row %d of %dx%d: %d vs. %d\n",
+                        kernel, i, rows, cols, actual.Data[i], expected.Data[i],
+                    )
+                    break
+                }
+            }
+        }
+    }
+}
+
+func TestMatrixMulPackedBatch(t *testing.T) {
+    // 40 rows over 3 threads leaves shares that aren't a multiple of 4
+    rows, cols, queries := uint64(40), uint64(37), uint64(9)
+    a := MatrixRand(rows, cols, 30, 0)
+    b := MatrixRand(cols*3, queries, 32, 0)
+
+    for _, threads := range []uint{ 1, 3 } {
+        batched := MatrixMulPacked(a, b, 10, 3, threads)
+        for q := uint64(0); q < queries; q++ {
+            expected := MatrixMulVecPackedWith(a, b.SelectColumn(q), 10, 3, PACKED_KERNEL_SCALAR)
+            for i := uint64(0); i < rows; i++ {
+                if batched.Get(i, q) != uint64(expected.Data[i]) {
+                    t.Errorf(
+                        "query %d differs at row %d with %d threads: %d vs. %d\n",
+                        q, i, threads, batched.Get(i, q), expected.Data[i],
+                    )
+                    break
+                }
+            }
+        }
+    }
+}
+
+func TestRowPartitions(t *testing.T) {
+    for _, rows := range []uint64{ 1, 15, 16, 100, 1000, 4097 } {
+        for _, threads := range []uint{ 1, 2, 3, 8, 64 } {
+            bounds := RowPartitions(rows, threads)
+            if bounds[0] != 0 || bounds[len(bounds)-1] != rows {
+                t.Errorf("partitions of %d rows don't cover them: %v\n", rows, bounds)
+            }
+            if uint(len(bounds)-1) > threads {
+                t.Errorf("%d rows split %d ways for %d threads\n", rows, len(bounds)-1, threads)
+            }
+            for i := 1; i+1 < len(bounds); i++ {
+                if bounds[i] % ROW_PARTITION_ALIGN != 0 || bounds[i] <= bounds[i-1] {
+                    t.Errorf("bad boundary %d of %d rows: %v\n", i, rows, bounds)
+                }
+            }
+        }
+    }
+}
+
+func TestMatrixMulVecPackedParallel(t *testing.T) {
+    a := MatrixRand(200, 51, 30, 0)
+    b := MatrixRand(51*3, 1, 32, 0)
+
+    expected := MatrixMulVecPacked(a, b, 10, 3)
+    for _, threads := range []uint{ 2, 3, 7 } {
+        actual := MatrixMulVecPackedParallel(a, b, 10, 3, threads)
+        for i := range expected.Data {
+            if expected.Data[i] != actual.Data[i] {
+                t.Errorf(
+                    "%d threads differ at row %d: %d vs. %d\n",
+                    threads, i, actual.Data[i], expected.Data[i],
+                )
+                break
+            }
+        }
+    }
+}
+
+func TestMatrixMulTiled(t *testing.T) {
+    // shapes straddle the tile sizes in every dimension
+    for _, dims := range [][3]uint64{ {3, 5, 7}, {67, 129, 257}, {130, 300, 600} } {
+        a := MatrixRand(dims[0], dims[1], 32, 0)
+        b := MatrixRand(dims[1], dims[2], 32, 0)
+
+        expected := MatrixMul(a, b)
+        for _, threads := range []uint{ 1, 3 } {
+            actual := MatrixMulTiled(a, b, threads)
+            for i := range expected.Data {
+                if expected.Data[i] != actual.Data[i] {
+                    t.Errorf(
+                        "%dx%dx%d with %d threads differs at %d: %d vs. %d\n",
+                        dims[0], dims[1], dims[2], threads, i, actual.Data[i], expected.Data[i],
+                    )
+                    break
+                }
+            }
+        }
+    }
+}
+
+// hint computation on a slice of the database for each of the configs/28-*
+// shapes, M columns of the database by the lwe dimension N
+func BenchmarkHint(b *testing.B) {
+    shapes := []struct { name string; m, n uint64 }{
+        { "large", 32768, 916 },
+        { "medium", 262144, 1097 },
+        { "small", 1048576, 1015 },
+    }
+    rows := uint64(64)
+
+    for _, shape := range shapes {
+        if testing.Short() && shape.m > 32768 { continue }
+
+        db := FasterMatrixRand(rows, shape.m)
+        A := FasterMatrixRand(shape.m, shape.n)
+        b.Run(fmt.Sprintf("%s/naive", shape.name), func(b *testing.B) {
+            for i := 0; i < b.N; i++ { MatrixMul(db, A) }
+        })
+        b.Run(fmt.Sprintf("%s/tiled", shape.name), func(b *testing.B) {
+            for i := 0; i < b.N; i++ { MatrixMulTiled(db, A, 1) }
+        })
+    }
+}
@@ -12,7 +12,7 @@ import (
 )
 
 const (
-    // size of pir input hash in bytes
+    // default size of pir input hash in bytes
     ENTRY_SIZE = 10
 
     // size of a matrix element in bytes
@@ -26,6 +26,9 @@ const (
 
     // number of bits in a byte
     BYTE_BITS = 8
+
+    // first u64 of a hashtable file written without its padding ("PSISPARS")
+    HASHTABLE_SPARSE_MAGIC = uint64(0x5352415053495350)
 )
 
 const RED    = "\033[0;31m"
@@ -164,6 +167,45 @@ func ReadDatabase[R ~uint64 | ~byte, W ~uint64 | ~byte](
     return metamap, values
 }
 
+/**
+ * read the server's hashtable as the bytes of each bucket padded out to the
+ *  bucket size, from either a padded file (the bucket size then every
+ *  bucket's bytes) or a sparse one (see HASHTABLE_SPARSE_MAGIC)
+ *
+ * @return bucket size in bytes and the padded table
+ */
+func ReadTable(filename string) (uint64, []uint64) {
+    file, err := os.ReadFile(filename)
+    if err != nil { panic(err) }
+    if len(file) < UINT64_SIZE { panic("hashtable file " + filename + " is too short") }
+
+    if binary.LittleEndian.Uint64(file) != HASHTABLE_SPARSE_MAGIC {
+        metadata, values := ReadDatabase[byte, uint64](filename, "bucketSize")
+        return metadata["bucketSize"], values
+    }
+
+    // the compact flag (header[4]) only matters to the oprf server
+    header := make([]uint64, 5)
+    reader := bytes.NewReader(file)
+    if binary.Read(reader, binary.LittleEndian, header) != nil { panic("truncated " + filename) }
+    width, buckets, entrySize := header[1], header[2], header[3]
+
+    lengths := make([]uint32, buckets)
+    if binary.Read(reader, binary.LittleEndian, lengths) != nil { panic("truncated " + filename) }
+
+    // fill the padding back in with zeros
+    entries := file[len(file) - reader.Len():]
+    values := make([]uint64, buckets * width)
+    for i, length := range lengths {
+        live := uint64(length) * entrySize
+        if live > width || live > uint64(len(entries)) { panic("truncated " + filename) }
+        bucket := values[uint64(i) * width:]
+        for j := uint64(0); j < live; j++ { bucket[j] = uint64(entries[j]) }
+        entries = entries[live:]
+    }
+    return width, values
+}
+
 func ModuloSwitchLength(elements uint64) uint64 {
     length := elements * MOD_SWITCH_BITS / BYTE_BITS
     if (elements * MOD_SWITCH_BITS) % BYTE_BITS != 0 { length++ }
@@ -273,6 +315,20 @@ func BytesToMatrix(input []byte, rows, cols uint64) *Matrix {
     return matrix
 }
 
+/**
+ * convert several byte arrays of <rows> uint32s into the columns of a matrix
+ */
+func BytesToColumns(inputs [][]byte, rows uint64) *Matrix {
+    cols := uint64(len(inputs))
+    matrix := MatrixNew(rows, cols)
+    for j, input := range inputs {
+        for i := uint64(0); i < rows; i++ {
+            matrix.Set(uint64(binary.LittleEndian.Uint32(input[i*4:(i+1)*4])), i, uint64(j))
+        }
+    }
+    return matrix
+}
+
 /**
  * makes it easy to track timing execution
  */
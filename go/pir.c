@@ -1,6 +1,12 @@
 
 #include "pir.h"
 #include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIR_X86 1
+#endif
 
 // Hard-coded, to allow for compiler optimizations:
 #define COMPRESSION 3
@@ -8,6 +14,15 @@
 #define BASIS2      BASIS*2
 #define MASK        (1<<BASIS)-1
 
+// Tile of the hint matMulTiled works on at once: 64x256 outputs (64KB) and
+// 128x256 of the lwe matrix (128KB) fit in L2, a row of either in L1.
+#define HINT_TILE_ROWS  64
+#define HINT_TILE_COLS  256
+#define HINT_TILE_INNER 128
+
+// Bytes of the query batch matMulPacked keeps in cache at once.
+#define PACKED_BLOCK_BYTES (1<<18)
+
 void matMul(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols, size_t bCols)
 {
@@ -20,6 +35,59 @@ void matMul(Elem *out, const Elem *a, const Elem *b,
   }
 }
 
+// Adds a[i][k]*b[k][j] over a tile of k to 4 consecutive rows of out, for
+// the columns [0, cols) of the current tile.
+static inline void tileUpdate4(Elem *restrict o1, Elem *restrict o2,
+    Elem *restrict o3, Elem *restrict o4, const Elem *a, const Elem *b,
+    size_t aCols, size_t bCols, size_t kTile, size_t cols)
+{
+  for (size_t k = 0; k < kTile; k++) {
+    Elem v1 = a[k], v2 = a[aCols + k], v3 = a[2*aCols + k], v4 = a[3*aCols + k];
+    const Elem *restrict row = b + k*bCols;
+    for (size_t j = 0; j < cols; j++) {
+      o1[j] += v1*row[j];
+      o2[j] += v2*row[j];
+      o3[j] += v3*row[j];
+      o4[j] += v4*row[j];
+    }
+  }
+}
+
+// Same as matMul, walking HINT_TILE_ROWS x HINT_TILE_COLS tiles of out and
+// HINT_TILE_INNER rows of b at a time, so the tile of b stays in cache while
+// every row of the tile of a uses it rather than being streamed from memory
+// once per row of a.
+void matMulTiled(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols, size_t bCols)
+{
+  for (size_t ii = 0; ii < aRows; ii += HINT_TILE_ROWS) {
+    size_t iEnd = ii + HINT_TILE_ROWS < aRows ? ii + HINT_TILE_ROWS : aRows;
+    for (size_t jj = 0; jj < bCols; jj += HINT_TILE_COLS) {
+      size_t cols = jj + HINT_TILE_COLS < bCols ? HINT_TILE_COLS : bCols - jj;
+      for (size_t kk = 0; kk < aCols; kk += HINT_TILE_INNER) {
+        size_t kTile = kk + HINT_TILE_INNER < aCols ? HINT_TILE_INNER : aCols - kk;
+
+        size_t i = ii;
+        for (; i + 4 <= iEnd; i += 4) {
+          Elem *o = out + i*bCols + jj;
+          tileUpdate4(o, o + bCols, o + 2*bCols, o + 3*bCols,
+              a + i*aCols + kk, b + kk*bCols + jj, aCols, bCols, kTile, cols);
+        }
+        for (; i < iEnd; i++) {
+          Elem *restrict o = out + i*bCols + jj;
+          for (size_t k = 0; k < kTile; k++) {
+            Elem v = a[i*aCols + kk + k];
+            const Elem *restrict row = b + (kk + k)*bCols + jj;
+            for (size_t j = 0; j < cols; j++) {
+              o[j] += v*row[j];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 void partialMatMul(
     Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols, size_t bCols,
@@ -110,7 +178,7 @@ void matMulVec(Elem *out, const Elem *a, const Elem *b,
   }
 }
 
-void matMulVecPacked(Elem *out, const Elem *a, const Elem *b,
+void matMulVecPackedScalar(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols)
 {
   Elem db, db2, db3, db4, db5, db6, db7, db8;
@@ -207,6 +275,279 @@ void matMulVecPacked(Elem *out, const Elem *a, const Elem *b,
   }
 }
 
+// Adds the products of one unpacked database entry of each of 4 rows with
+// the matching rows of b to those rows of out.
+static inline void packedUpdate4(Elem *restrict o1, Elem *restrict o2,
+    Elem *restrict o3, Elem *restrict o4, const Elem *restrict b1,
+    const Elem *restrict b2, const Elem *restrict b3, const Elem *db,
+    size_t bCols)
+{
+  Elem v1 = db[0] & MASK, w1 = (db[0] >> BASIS) & MASK, x1 = (db[0] >> BASIS2) & MASK;
+  Elem v2 = db[1] & MASK, w2 = (db[1] >> BASIS) & MASK, x2 = (db[1] >> BASIS2) & MASK;
+  Elem v3 = db[2] & MASK, w3 = (db[2] >> BASIS) & MASK, x3 = (db[2] >> BASIS2) & MASK;
+  Elem v4 = db[3] & MASK, w4 = (db[3] >> BASIS) & MASK, x4 = (db[3] >> BASIS2) & MASK;
+  for (size_t j = 0; j < bCols; j++) {
+    o1[j] += v1*b1[j] + w1*b2[j] + x1*b3[j];
+    o2[j] += v2*b1[j] + w2*b2[j] + x2*b3[j];
+    o3[j] += v3*b1[j] + w3*b2[j] + x3*b3[j];
+    o4[j] += v4*b1[j] + w4*b2[j] + x4*b3[j];
+  }
+}
+
+// Computes out += unpacked(a) * b for a whole batch of query vectors, stacked
+// as the bCols columns of b (so b has aCols*COMPRESSION rows). Each database
+// entry is loaded and unpacked once for the batch: the columns of a are walked
+// in blocks whose slice of b stays in cache across all the rows, and four
+// rows are updated together so every load of b is shared.
+void matMulPacked(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols, size_t bCols)
+{
+  size_t block = PACKED_BLOCK_BYTES / (COMPRESSION * bCols * sizeof(Elem));
+  if (block == 0) block = 1;
+  size_t rows = aRows - aRows % 4;
+
+  for (size_t start = 0; start < aCols; start += block) {
+    size_t end = start + block < aCols ? start + block : aCols;
+
+    for (size_t i = 0; i < rows; i += 4) {
+      for (size_t k = start; k < end; k++) {
+        Elem db[4] = { a[i*aCols + k], a[(i+1)*aCols + k], a[(i+2)*aCols + k], a[(i+3)*aCols + k] };
+        const Elem *b1 = b + (k*COMPRESSION)*bCols;
+        packedUpdate4(out + i*bCols, out + (i+1)*bCols, out + (i+2)*bCols, out + (i+3)*bCols,
+            b1, b1 + bCols, b1 + 2*bCols, db, bCols);
+      }
+    }
+
+    for (size_t i = rows; i < aRows; i++) {
+      Elem *row = out + i*bCols;
+      for (size_t k = start; k < end; k++) {
+        Elem db = a[i*aCols + k];
+        Elem val = db & MASK;
+        Elem val2 = (db >> BASIS) & MASK;
+        Elem val3 = (db >> BASIS2) & MASK;
+        const Elem *b1 = b + (k*COMPRESSION)*bCols;
+        for (size_t j = 0; j < bCols; j++) {
+          row[j] += val*b1[j] + val2*b1[bCols + j] + val3*b1[2*bCols + j];
+        }
+      }
+    }
+  }
+}
+
+// Splits b into the coefficients of each of the COMPRESSION squished
+// lanes, so the vector kernels can load them contiguously.
+static Elem *deinterleave(const Elem *b, size_t aCols)
+{
+  Elem *lanes = malloc(COMPRESSION * aCols * sizeof(Elem));
+  for (size_t j = 0; j < aCols; j++) {
+    for (int m = 0; m < COMPRESSION; m++) {
+      lanes[m*aCols + j] = b[j*COMPRESSION + m];
+    }
+  }
+  return lanes;
+}
+
+// Dot product of one packed row with b from column `from` on, for the
+// columns the vector kernels have left over.
+static Elem packedRowTail(const Elem *row, const Elem *b, size_t from, size_t aCols)
+{
+  Elem tmp = 0;
+  for (size_t j = from; j < aCols; j++) {
+    Elem db = row[j];
+    tmp += (db & MASK)*b[j*COMPRESSION];
+    tmp += ((db >> BASIS) & MASK)*b[j*COMPRESSION+1];
+    tmp += ((db >> BASIS2) & MASK)*b[j*COMPRESSION+2];
+  }
+  return tmp;
+}
+
+#ifdef PIR_X86
+
+__attribute__((target("avx2")))
+static Elem sumAVX2(__m256i v)
+{
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (Elem) _mm_cvtsi128_si32(s);
+}
+
+// Unpacks the three 10-bit lanes of 8 database entries and accumulates
+// their products with the matching coefficients into acc.
+__attribute__((target("avx2")))
+static inline __m256i unpackMulAddAVX2(__m256i acc, __m256i db,
+    __m256i b0, __m256i b1, __m256i b2)
+{
+  const __m256i mask = _mm256_set1_epi32(MASK);
+  acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_and_si256(db, mask), b0));
+  acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(
+      _mm256_and_si256(_mm256_srli_epi32(db, BASIS), mask), b1));
+  acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(
+      _mm256_and_si256(_mm256_srli_epi32(db, BASIS2), mask), b2));
+  return acc;
+}
+
+__attribute__((target("avx2")))
+void matMulVecPackedAVX2(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  Elem *lanes = deinterleave(b, aCols);
+  const Elem *b0 = lanes, *b1 = lanes + aCols, *b2 = lanes + 2*aCols;
+  size_t cols = aCols - aCols % 8;
+  size_t i = 0;
+
+  // four rows at a time share each load of the coefficients
+  for (; i + 4 <= aRows; i += 4) {
+    const Elem *r0 = a + i*aCols, *r1 = r0 + aCols, *r2 = r1 + aCols, *r3 = r2 + aCols;
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    for (size_t j = 0; j < cols; j += 8) {
+      __m256i c0 = _mm256_loadu_si256((const __m256i *) (b0 + j));
+      __m256i c1 = _mm256_loadu_si256((const __m256i *) (b1 + j));
+      __m256i c2 = _mm256_loadu_si256((const __m256i *) (b2 + j));
+      acc0 = unpackMulAddAVX2(acc0, _mm256_loadu_si256((const __m256i *) (r0 + j)), c0, c1, c2);
+      acc1 = unpackMulAddAVX2(acc1, _mm256_loadu_si256((const __m256i *) (r1 + j)), c0, c1, c2);
+      acc2 = unpackMulAddAVX2(acc2, _mm256_loadu_si256((const __m256i *) (r2 + j)), c0, c1, c2);
+      acc3 = unpackMulAddAVX2(acc3, _mm256_loadu_si256((const __m256i *) (r3 + j)), c0, c1, c2);
+    }
+    out[i]   += sumAVX2(acc0) + packedRowTail(r0, b, cols, aCols);
+    out[i+1] += sumAVX2(acc1) + packedRowTail(r1, b, cols, aCols);
+    out[i+2] += sumAVX2(acc2) + packedRowTail(r2, b, cols, aCols);
+    out[i+3] += sumAVX2(acc3) + packedRowTail(r3, b, cols, aCols);
+  }
+
+  for (; i < aRows; i++) {
+    const Elem *r0 = a + i*aCols;
+    __m256i acc0 = _mm256_setzero_si256();
+    for (size_t j = 0; j < cols; j += 8) {
+      acc0 = unpackMulAddAVX2(acc0, _mm256_loadu_si256((const __m256i *) (r0 + j)),
+          _mm256_loadu_si256((const __m256i *) (b0 + j)),
+          _mm256_loadu_si256((const __m256i *) (b1 + j)),
+          _mm256_loadu_si256((const __m256i *) (b2 + j)));
+    }
+    out[i] += sumAVX2(acc0) + packedRowTail(r0, b, cols, aCols);
+  }
+
+  free(lanes);
+}
+
+// Same as unpackMulAddAVX2, over 16 database entries.
+__attribute__((target("avx512f")))
+static inline __m512i unpackMulAddAVX512(__m512i acc, __m512i db,
+    __m512i b0, __m512i b1, __m512i b2)
+{
+  const __m512i mask = _mm512_set1_epi32(MASK);
+  acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(_mm512_and_si512(db, mask), b0));
+  acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(
+      _mm512_and_si512(_mm512_srli_epi32(db, BASIS), mask), b1));
+  acc = _mm512_add_epi32(acc, _mm512_mullo_epi32(
+      _mm512_and_si512(_mm512_srli_epi32(db, BASIS2), mask), b2));
+  return acc;
+}
+
+__attribute__((target("avx512f")))
+void matMulVecPackedAVX512(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  Elem *lanes = deinterleave(b, aCols);
+  const Elem *b0 = lanes, *b1 = lanes + aCols, *b2 = lanes + 2*aCols;
+  size_t cols = aCols - aCols % 16;
+  size_t i = 0;
+
+  for (; i + 4 <= aRows; i += 4) {
+    const Elem *r0 = a + i*aCols, *r1 = r0 + aCols, *r2 = r1 + aCols, *r3 = r2 + aCols;
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    for (size_t j = 0; j < cols; j += 16) {
+      __m512i c0 = _mm512_loadu_si512(b0 + j);
+      __m512i c1 = _mm512_loadu_si512(b1 + j);
+      __m512i c2 = _mm512_loadu_si512(b2 + j);
+      acc0 = unpackMulAddAVX512(acc0, _mm512_loadu_si512(r0 + j), c0, c1, c2);
+      acc1 = unpackMulAddAVX512(acc1, _mm512_loadu_si512(r1 + j), c0, c1, c2);
+      acc2 = unpackMulAddAVX512(acc2, _mm512_loadu_si512(r2 + j), c0, c1, c2);
+      acc3 = unpackMulAddAVX512(acc3, _mm512_loadu_si512(r3 + j), c0, c1, c2);
+    }
+    out[i]   += (Elem) _mm512_reduce_add_epi32(acc0) + packedRowTail(r0, b, cols, aCols);
+    out[i+1] += (Elem) _mm512_reduce_add_epi32(acc1) + packedRowTail(r1, b, cols, aCols);
+    out[i+2] += (Elem) _mm512_reduce_add_epi32(acc2) + packedRowTail(r2, b, cols, aCols);
+    out[i+3] += (Elem) _mm512_reduce_add_epi32(acc3) + packedRowTail(r3, b, cols, aCols);
+  }
+
+  for (; i < aRows; i++) {
+    const Elem *r0 = a + i*aCols;
+    __m512i acc0 = _mm512_setzero_si512();
+    for (size_t j = 0; j < cols; j += 16) {
+      acc0 = unpackMulAddAVX512(acc0, _mm512_loadu_si512(r0 + j),
+          _mm512_loadu_si512(b0 + j), _mm512_loadu_si512(b1 + j), _mm512_loadu_si512(b2 + j));
+    }
+    out[i] += (Elem) _mm512_reduce_add_epi32(acc0) + packedRowTail(r0, b, cols, aCols);
+  }
+
+  free(lanes);
+}
+
+#else
+
+void matMulVecPackedAVX2(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  matMulVecPackedScalar(out, a, b, aRows, aCols);
+}
+
+void matMulVecPackedAVX512(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  matMulVecPackedScalar(out, a, b, aRows, aCols);
+}
+
+#endif
+
+int packedKernelSupported(int kernel)
+{
+  switch (kernel) {
+  case PACKED_KERNEL_SCALAR:
+    return 1;
+#ifdef PIR_X86
+  case PACKED_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") != 0;
+  case PACKED_KERNEL_AVX512:
+    return __builtin_cpu_supports("avx512f") != 0;
+#endif
+  default:
+    return 0;
+  }
+}
+
+int packedKernel(void)
+{
+  static int kernel = -1;
+  if (kernel < 0) {
+    kernel = packedKernelSupported(PACKED_KERNEL_AVX512) ? PACKED_KERNEL_AVX512 :
+             packedKernelSupported(PACKED_KERNEL_AVX2) ? PACKED_KERNEL_AVX2 :
+             PACKED_KERNEL_SCALAR;
+  }
+  return kernel;
+}
+
+void matMulVecPackedWith(int kernel, Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  switch (kernel) {
+  case PACKED_KERNEL_AVX512:
+    matMulVecPackedAVX512(out, a, b, aRows, aCols);
+    break;
+  case PACKED_KERNEL_AVX2:
+    matMulVecPackedAVX2(out, a, b, aRows, aCols);
+    break;
+  default:
+    matMulVecPackedScalar(out, a, b, aRows, aCols);
+  }
+}
+
+void matMulVecPacked(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols)
+{
+  matMulVecPackedWith(packedKernel(), out, a, b, aRows, aCols);
+}
+
 void transpose(Elem *out, const Elem *in, size_t rows, size_t cols)
 {
   for (size_t i = 0; i < rows; i++) {
@@ -8,6 +8,9 @@ void transpose(Elem *out, const Elem *in, size_t rows, size_t cols);
 void matMul(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols, size_t bCols);
 
+void matMulTiled(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols, size_t bCols);
+
 void partialMatMul(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols, size_t bCols, size_t row);
 
@@ -17,5 +20,29 @@ void matMulTransposedPacked(Elem *out, const Elem *a, const Elem *b,
 void matMulVec(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols);
 
+// Kernels behind matMulVecPacked, picked by what the CPU supports.
+#define PACKED_KERNEL_SCALAR 0
+#define PACKED_KERNEL_AVX2   1
+#define PACKED_KERNEL_AVX512 2
+
 void matMulVecPacked(Elem *out, const Elem *a, const Elem *b,
     size_t aRows, size_t aCols);
+
+void matMulPacked(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols, size_t bCols);
+
+void matMulVecPackedWith(int kernel, Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols);
+
+void matMulVecPackedScalar(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols);
+
+void matMulVecPackedAVX2(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols);
+
+void matMulVecPackedAVX512(Elem *out, const Elem *a, const Elem *b,
+    size_t aRows, size_t aCols);
+
+int packedKernelSupported(int kernel);
+
+int packedKernel(void);
@@ -14,6 +14,30 @@ type PSIParams struct {
     LweN     int64
     LweSigma float64
     Modulus  int64
+
+    // (optional) client writes the recovered columns here for the resolver
+    Recovered string
+
+    // (optional) keep the hint between runs so changes only send its deltas
+    HintDir   string // server's hint store, or client's cached hint
+    HintDelta string // server checks its changed bytes against the buckets listed here
+    Table     uint64 // which of the cuckoo table's hashtables this is
+
+    // (optional) split the cuckoo table's hashtables between several servers
+    Shard  uint64 // which server this is
+    Shards uint64 // how many servers there are
+}
+
+/**
+ * the cuckoo table's hashtables this server holds, every <Shards>th one
+ *  starting from <Shard> (all of them if there is one server)
+ */
+func (p* PSIParams) Tables() []uint64 {
+    tables := make([]uint64, 0)
+    for table := p.Shard; table < p.CuckooSize; table += p.Shards {
+        tables = append(tables, table)
+    }
+    return tables
 }
 
 /**
@@ -48,12 +48,12 @@ func RunServer(psiParams *PSIParams, client net.Conn, queries uint64) {
             states[i] = state
         }
     } else if psiParams.Threads == 1 {
-        states = make([]*ServerState, psiParams.CuckooSize)
+        states = make([]*ServerState, len(datasets))
         for i := range datasets {
             states[i] = CreateServerState(&params[i], datasets[i])
         }
     } else {
-        states = make([]*ServerState, psiParams.CuckooSize)
+        states = make([]*ServerState, len(datasets))
         var waitGroup sync.WaitGroup
         for i := range datasets {
             waitGroup.Add(1)
@@ -69,7 +69,7 @@ func RunServer(psiParams *PSIParams, client net.Conn, queries uint64) {
 
     ///////////////////////////////////////////////////////////
 
-    for i := uint64(0); i < psiParams.CuckooSize; i++ {
+    for i := range datasets {
         p := states[i].Params
         fmt.Printf("[  both  ] db dims (elems)\t: %dx%d\n", p.L, p.M)
 
@@ -85,12 +85,19 @@ func RunServer(psiParams *PSIParams, client net.Conn, queries uint64) {
     client.Write(ready)
 
     comm := 0
-    for i := uint64(0); i < psiParams.CuckooSize; i++ {
+    for i := range datasets {
         err := binary.Write(client, binary.LittleEndian, &states[i].BucketSize)
         if err != nil { panic(err) }
-        WriteOverNetwork(client, states[i].Offline)
+
+        // only send as much of the hint as the client's cached one lacks
+        var cached uint64
+        var seed PRGKey
+        err = binary.Read(client, binary.LittleEndian, &cached)
+        if err != nil { panic(err) }
+        err = binary.Read(client, binary.LittleEndian, seed[:])
+        if err != nil { panic(err) }
         comm += UINT64_SIZE
-        comm += len(states[i].Offline)
+        comm += states[i].WriteHint(client, cached, seed)
     }
 
     fmt.Printf("[  both  ] hint comm (MB)\t: %.3f\n", float64(comm) / 1000000)
@@ -104,7 +111,21 @@ func RunServer(psiParams *PSIParams, client net.Conn, queries uint64) {
     upload := 0
     download := 0
     timer = StartTimer("[ server ] pir end2end", BLUE)
-    if psiParams.Threads == 1 || len(states) == 1 {
+    if psiParams.CuckooSize == 1 && len(states) > 1 {
+        // every query is against the same database, so answer them together
+        requests := make([][]byte, len(states))
+        for i, state := range states {
+            requests[i] = ReadOverNetwork(client, state.QuerySize * ELEMENT_SIZE)
+            upload += len(requests[i])
+        }
+        comp := StartTimer("[ server ] online comp", BLUE)
+        responses := states[0].AnswerQueries(requests, psiParams.Threads)
+        comp.End()
+        for _, response := range responses {
+            WriteOverNetwork(client, response)
+            download += len(response)
+        }
+    } else if psiParams.Threads == 1 || len(states) == 1 {
         requests := make([][]byte, len(states))
         responses := make([][]byte, len(states))
         for i, state := range states {
@@ -159,6 +180,9 @@ type ServerState struct {
     BucketSize uint64
     LweMatrix  State
     Offline    []byte
+    Threads    uint   // threads to split the database rows across when answering
+    Version    uint64     // version of the hint (HINT_UNVERSIONED if not kept)
+    Store      *HintStore // where the hint and its deltas are kept, if anywhere
 }
 
 func CreateServerState(psiParams *PSIParams, dataset []uint64) *ServerState {
@@ -167,6 +191,16 @@ func CreateServerState(psiParams *PSIParams, dataset []uint64) *ServerState {
     protocol, params, ENTRY_BITS := SetupProtocol(psiParams)
     db := CreateDatabase(ENTRY_BITS, params, dataset)
 
+    // a hint kept from a previous run on a database of the same shape only
+    //  needs the rows the changes touched recomputed
+    var store *HintStore
+    if psiParams.HintDir != "" {
+        store = LoadHintStore(HintDir(psiParams.HintDir, psiParams.Table, psiParams.CuckooSize))
+    }
+    if store != nil && store.Matches(params, psiParams.BucketSize, dataset) {
+        return UpdateServerState(psiParams, protocol, params, db, dataset, store)
+    }
+
     // the SimplePIR library has a global prng so the this cannot be parallelized
     mutex.Lock()
 
@@ -182,11 +216,87 @@ func CreateServerState(psiParams *PSIParams, dataset []uint64) *ServerState {
     _, hint := protocol.Setup(db, lweMatrix, *params, *psiParams)
     timer.End()
 
+    // start a new version that no stored delta applies to
+    version := HINT_UNVERSIONED
+    if psiParams.HintDir != "" {
+        version = 1
+        if store != nil { version = store.Version + 1 }
+        store = &HintStore{
+            Dir: HintDir(psiParams.HintDir, psiParams.Table, psiParams.CuckooSize),
+            Version: version,
+            Base: version,
+            Seed: *seed.Seed,
+            L: params.L, M: params.M, N: params.N, P: params.P,
+            BucketSize: psiParams.BucketSize,
+            Hint: hint.Data[0],
+            Data: dataset,
+        }
+        store.Save()
+    }
+
+    return NewServerState(psiParams, params, db, lweMatrix, *seed.Seed, hint.Data[0], version, store)
+}
+
+/**
+ * bring a stored hint up to date with the database instead of recomputing it
+ */
+func UpdateServerState(
+    psiParams *PSIParams,
+    protocol SimplePIR,
+    params *Params,
+    db *Database,
+    dataset []uint64,
+    store *HintStore,
+) *ServerState {
+    mutex.Lock()
+    timer := StartTimer("[ server ] lwe matrix", BLUE)
+    lweMatrix := protocol.DecompressState(db.Info, *params, MakeCompressedState(&store.Seed))
+    timer.End()
+    mutex.Unlock()
+
+    timer = StartTimer("[ server ] update hint", BLUE)
+    // every byte is compared, as the update file can be stale (or predate a
+    //  re-key) and a missed byte would leave the stored hint wrong for good
+    if psiParams.HintDelta != "" {
+        buckets := ReadDirtyBuckets(psiParams.HintDelta, psiParams.Table)
+        if buckets != nil {
+            unlisted := UnlistedChanges(store.Data, dataset, BucketPositions(buckets, psiParams.BucketSize))
+            if unlisted > 0 {
+                fmt.Printf("[ server ] %d changed bytes outside the buckets in %s\n", unlisted, psiParams.HintDelta)
+            }
+        }
+    }
+    rows := UpdateHint(store.Hint, lweMatrix.Data[0], store.Data, dataset, db.Info, params.L)
+    if len(rows) > 0 {
+        store.Version++
+        store.SaveDelta(MakeHintDelta(store.Hint, rows, store.Version))
+        store.Data = dataset
+        store.Save()
+    }
+    timer.End()
+    fmt.Printf("[ server ] hint rows changed\t: %d\n", len(rows))
+
+    // same as the end of SimplePIR.Setup()
+    db.Data.Add(params.P / 2)
+    db.Squish()
+
+    return NewServerState(psiParams, params, db, lweMatrix, store.Seed, store.Hint, store.Version, store)
+}
+
+func NewServerState(
+    psiParams *PSIParams,
+    params *Params,
+    db *Database,
+    lweMatrix State,
+    seed PRGKey,
+    hint *Matrix,
+    version uint64,
+    store *HintStore,
+) *ServerState {
     // gather lwe matrix seed and hint into 'offline' dataset
     var bytes = make([]byte, aes.BlockSize)
-    ptr := *seed.Seed
-    copy(bytes[:], ptr[:])
-    offline := append(bytes, ModuloSwitch(hint.Data[0])...)
+    copy(bytes[:], seed[:])
+    offline := append(bytes, ModuloSwitch(hint)...)
 
     // expected size of incoming query vectors
     querySize := params.M
@@ -196,6 +306,10 @@ func CreateServerState(psiParams *PSIParams, dataset []uint64) *ServerState {
 		querySize += db.Info.Squishing - (params.M % db.Info.Squishing)
 	}
 
+    // sub-tables are answered concurrently, so they share the threads
+    threads := psiParams.Threads / uint(psiParams.CuckooSize)
+    if threads < 1 { threads = 1 }
+
     return &ServerState{
         Params: params,
         DB: db,
@@ -203,12 +317,23 @@ func CreateServerState(psiParams *PSIParams, dataset []uint64) *ServerState {
         BucketSize: psiParams.BucketSize,
         LweMatrix: lweMatrix,
         Offline: offline,
+        Threads: threads,
+        Version: version,
+        Store: store,
     }
 }
 
 func (state* ServerState) AnswerQuery(request []byte) []byte {
-    protocol := SimplePIR{}
     query := BytesToMatrix(request, state.QuerySize, 1)
+    if state.Threads > 1 {
+        // same as SimplePIR.Answer for a single query, split across threads
+        answer := MatrixMulVecPackedParallel(
+            state.DB.Data, query, state.DB.Info.Basis, state.DB.Info.Squishing, state.Threads,
+        )
+        return ModuloSwitch(answer)
+    }
+
+    protocol := SimplePIR{}
     answer := protocol.Answer(
         state.DB,
         MakeMsgSlice(MakeMsg(query)),
@@ -219,21 +344,42 @@ func (state* ServerState) AnswerQuery(request []byte) []byte {
     return ModuloSwitch(answer.Data[0])
 }
 
+/**
+ * answer a batch of queries against the same database in one pass over it
+ *
+ * @param <threads> number of threads to split the database rows across
+ */
+func (state* ServerState) AnswerQueries(requests [][]byte, threads uint) [][]byte {
+    // stack the queries as the columns of one matrix
+    queries := BytesToColumns(requests, state.QuerySize)
+
+    answers := MatrixMulPacked(
+        state.DB.Data, queries, state.DB.Info.Basis, state.DB.Info.Squishing, threads,
+    )
+
+    responses := make([][]byte, len(requests))
+    for q := range requests {
+        responses[q] = ModuloSwitch(answers.SelectColumn(uint64(q)))
+    }
+    return responses
+}
+
 func ReadServerInputs(psiParams PSIParams) ([][]uint64, []PSIParams ) {
-    datasets := make([][]uint64, psiParams.CuckooSize)
-    params   := make([]PSIParams, psiParams.CuckooSize)
+    datasets := make([][]uint64, len(psiParams.Tables()))
+    params   := make([]PSIParams, len(psiParams.Tables()))
 
-    for i := uint64(0); i < psiParams.CuckooSize; i++ {
+    for i, table := range psiParams.Tables() {
         filename := SERVER_DATABASE
         if (psiParams.CuckooSize > 1) {
             filename = fmt.Sprintf(
-                "%s%d%s", SERVER_DATABASE_PREFIX, i, SERVER_DATABASE_SUFFIX,
+                "%s%d%s", SERVER_DATABASE_PREFIX, table, SERVER_DATABASE_SUFFIX,
             )
         }
-        metadata, dataset := ReadDatabase[byte, uint64](filename, "bucketSize")
+        bucketSize, dataset := ReadTable(filename)
 
         params[i] = psiParams
-        params[i].BucketSize = metadata["bucketSize"]
+        params[i].BucketSize = bucketSize
+        params[i].Table = table
 
         if uint64(len(dataset)) != params[i].DBBytes() {
             panic("database size inconsistent between file and params")
@@ -124,12 +124,10 @@ func (pi *SimplePIR) Setup(
     psiParams PSIParams,
 ) (State, Msg) {
 	A := shared.Data[0]
-    var H *Matrix
-    if psiParams.Threads > 1 && psiParams.CuckooSize == 1 {
-        H = MultiMatrixMul(DB.Data, A)
-    } else {
-        H = MatrixMul(DB.Data, A)
-    }
+    // sub-tables are set up concurrently, so they share the threads
+    threads := psiParams.Threads / uint(psiParams.CuckooSize)
+    if threads < 1 { threads = 1 }
+    H := MatrixMulTiled(DB.Data, A, threads)
 
 	// map the database entries to [0, p] (rather than [-p/1, p/2]) and then
 	// pack the database more tightly in memory, because the online computation
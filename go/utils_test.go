@@ -1,6 +1,8 @@
 package main
 
 import (
+    "bytes"
+    "encoding/binary"
     "os"
     "path/filepath"
     "strconv"
@@ -66,3 +68,36 @@ func TestModuloSwitchingZeros(t *testing.T) {
         }
     }
 }
+
+func TestReadTable(t *testing.T) {
+    // 3 buckets of up to two 2 byte entries holding 1, 0 and 2 entries
+    width, entrySize := uint64(4), uint64(2)
+    lengths := []uint32{ 1, 0, 2 }
+    entries := []byte{ 1, 2, 3, 4, 5, 6 }
+    expected := []uint64{ 1, 2, 0, 0, 0, 0, 0, 0, 3, 4, 5, 6 }
+
+    var sparse bytes.Buffer
+    binary.Write(&sparse, binary.LittleEndian, []uint64{ HASHTABLE_SPARSE_MAGIC, width, 3, entrySize, 1 })
+    binary.Write(&sparse, binary.LittleEndian, lengths)
+    sparse.Write(entries)
+
+    var padded bytes.Buffer
+    binary.Write(&padded, binary.LittleEndian, width)
+    for _, value := range expected { padded.WriteByte(byte(value)) }
+
+    dir := t.TempDir()
+    for name, contents := range map[string][]byte{ "sparse": sparse.Bytes(), "padded": padded.Bytes() } {
+        filename := filepath.Join(dir, name + ".edb")
+        if err := os.WriteFile(filename, contents, 0644); err != nil { t.Fatal(err) }
+
+        bucketSize, values := ReadTable(filename)
+        if bucketSize != width || len(values) != len(expected) {
+            t.Fatalf("%s table read as %d bytes of %d byte buckets\n", name, len(values), bucketSize)
+        }
+        for i := range expected {
+            if values[i] != expected[i] {
+                t.Errorf("%s table differs at %d: %d vs. %d\n", name, i, values[i], expected[i])
+            }
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#include "batcher.h"
+
+#include <cstring>
+
+namespace unbalanced_psi {
+
+    OPRFBatcher::OPRFBatcher(evaluator e, int t, u64 points, u64 delay) :
+        evaluate_points(e), threads(std::max(t, 1)), max_points(points),
+        max_delay(delay), queued_points(0), stopping(false) {
+        scheduler = std::thread(&OPRFBatcher::run, this);
+    }
+
+    OPRFBatcher::~OPRFBatcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pending.notify_all();
+        scheduler.join();
+    }
+
+    void OPRFBatcher::evaluate(const u8* request, u8* response, u64 count) {
+        if (count == 0) { return; }
+
+        std::promise<void> promise;
+        auto done = promise.get_future();
+        submit(request, response, count, [&promise](std::exception_ptr failure) {
+            if (failure) {
+                promise.set_exception(failure);
+            } else {
+                promise.set_value();
+            }
+        });
+        done.get();
+    }
+
+    void OPRFBatcher::submit(
+        const u8* request, u8* response, u64 count, std::function<void(std::exception_ptr)> done
+    ) {
+        if (count == 0) {
+            done(nullptr);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(Request{
+                request, response, count, std::chrono::steady_clock::now(), std::move(done), false
+            });
+            queued_points += count;
+        }
+        pending.notify_all();
+    }
+
+    OPRFBatcher::Evaluation OPRFBatcher::evaluate_async(const u8* request, u8* response, u64 count) {
+        return Evaluation{*this, request, response, count, nullptr};
+    }
+
+    void OPRFBatcher::run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            pending.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) { return; }
+
+            // give other sessions until the oldest request's deadline to join
+            auto deadline = queue.front().arrival + max_delay;
+            pending.wait_until(lock, deadline, [this]() {
+                return stopping || queued_points >= max_points;
+            });
+
+            // always take the oldest request so nobody is starved, then fill
+            //  the batch in arrival order
+            vector<Request> batch;
+            u64 points = 0;
+            do {
+                points += queue.front().count;
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            } while (!queue.empty() && points + queue.front().count <= max_points);
+            queued_points -= points;
+
+            lock.unlock();
+            try {
+                process(batch);
+            } catch (...) {
+                // hand the failure to every session still waiting
+                for (auto& request : batch) {
+                    if (request.finished) { continue; }
+                    request.finished = true;
+                    request.done(std::current_exception());
+                }
+            }
+            lock.lock();
+        }
+    }
+
+    void OPRFBatcher::process(vector<Request>& batch) {
+        // a lone request needs no gathering
+        if (batch.size() == 1 && threads == 1) {
+            evaluate_points(batch[0].input, batch[0].output, batch[0].count);
+            batch[0].finished = true;
+            batch[0].done(nullptr);
+            return;
+        }
+
+        // gather into one contiguous run of points
+        u64 points = 0;
+        for (auto& request : batch) { points += request.count; }
+
+        vector<u8> input(points * Point::save_size);
+        vector<u8> output(input.size());
+        auto iter = input.data();
+        for (auto& request : batch) {
+            std::memcpy(iter, request.input, request.count * Point::save_size);
+            iter += request.count * Point::save_size;
+        }
+
+        // evaluate in seperate threads
+        u64 per_thread = points / threads + (points % threads != 0);
+        vector<future<void>> futures;
+        for (u64 begin = 0; begin < points; begin += per_thread) {
+            u64 count = std::min(per_thread, points - begin);
+            futures.push_back(std::async(
+                std::launch::async,
+                evaluate_points,
+                input.data() + begin * Point::save_size,
+                output.data() + begin * Point::save_size,
+                count
+            ));
+        }
+        for (auto& f : futures) { f.get(); }
+
+        // scatter back to each session
+        iter = output.data();
+        for (auto& request : batch) {
+            std::memcpy(request.output, iter, request.count * Point::save_size);
+            iter += request.count * Point::save_size;
+        }
+        for (auto& request : batch) {
+            request.finished = true;
+            request.done(nullptr);
+        }
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "defines.h"
+
+// default most points to evaluate in one batch
+#define BATCH_MAX_POINTS u64(1 << 16)
+
+// default longest a request waits for others to join its batch (microseconds)
+#define BATCH_MAX_DELAY u64(2000)
+
+namespace unbalanced_psi {
+
+    /**
+     * coalesces oprf requests from concurrent client sessions into large
+     *  batches, evaluates each batch across every thread, and scatters the
+     *  results back to the sessions they came from
+     */
+    class OPRFBatcher {
+
+        public:
+
+        // encrypts <count> serialized points from <input> into <output>
+        using evaluator = std::function<void(const u8* input, u8* output, u64 count)>;
+
+        /**
+         * start the scheduler thread
+         *
+         * @params <evaluate> how to encrypt a run of points
+         * @params <threads> number of threads to split each batch over
+         * @params <max_points> stop waiting once this many points are queued
+         * @params <max_delay> microseconds the oldest request may wait
+         */
+        OPRFBatcher(evaluator evaluate, int threads, u64 max_points, u64 max_delay);
+
+        /**
+         * finish queued requests and stop the scheduler thread
+         */
+        ~OPRFBatcher();
+
+        /**
+         * queue serialized points and block until they have been encrypted
+         *
+         * @params <request> points from one client session
+         * @params <response> where to put the encrypted points
+         * @params <count> number of points
+         */
+        void evaluate(const u8* request, u8* response, u64 count);
+
+        /**
+         * queue serialized points without waiting for them
+         *
+         * @params <done> called from the scheduler thread once the points
+         *                are encrypted, with the error if that failed
+         */
+        void submit(const u8* request, u8* response, u64 count, std::function<void(std::exception_ptr)> done);
+
+        /**
+         * awaitable form of evaluate() for coroutine sessions, resumed from
+         *  the scheduler thread so no thread is blocked while they wait
+         */
+        struct Evaluation {
+            OPRFBatcher& batcher;
+            const u8* request;
+            u8* response;
+            u64 count;
+            std::exception_ptr error;
+
+            bool await_ready() { return count == 0; }
+
+            template<typename Handle>
+            void await_suspend(Handle handle) {
+                batcher.submit(request, response, count, [this, handle](std::exception_ptr failure) mutable {
+                    error = failure;
+                    handle.resume();
+                });
+            }
+
+            void await_resume() {
+                if (error) { std::rethrow_exception(error); }
+            }
+        };
+
+        /**
+         * same as evaluate() but awaited rather than blocking
+         */
+        Evaluation evaluate_async(const u8* request, u8* response, u64 count);
+
+        private:
+
+        struct Request {
+            const u8* input;
+            u8* output;
+            u64 count;
+            std::chrono::steady_clock::time_point arrival;
+            std::function<void(std::exception_ptr)> done;
+            bool finished;
+        };
+
+        evaluator evaluate_points;
+        int threads;
+        u64 max_points;
+        std::chrono::microseconds max_delay;
+
+        std::mutex mutex;
+        std::condition_variable pending;
+        std::deque<Request> queue;
+        u64 queued_points;
+        bool stopping;
+
+        std::thread scheduler;
+
+        /**
+         * take batches off the queue until stopped
+         */
+        void run();
+
+        /**
+         * evaluate the requests as one contiguous batch
+         */
+        void process(vector<Request>& batch);
+    };
+}
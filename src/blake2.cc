@@ -0,0 +1,184 @@
+#include "blake2.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace unbalanced_psi {
+
+    static const u64 IV[8] = {
+        0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+        0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+    };
+
+    static const u8 SIGMA[12][16] = {
+        {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+        { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+        { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+        {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+        {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+        {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+        { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+        { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+        {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+        { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+        {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+        { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+    };
+
+    /**
+     * the message words of one zero-padded block (little endian, which is
+     *  what blake2b reads)
+     */
+    static void block_words(const u8* input, u64 input_size, u64 words[16]) {
+        u8 block[BLAKE2B_BLOCK_SIZE] = { 0 };
+        std::memcpy(block, input, input_size);
+        std::memcpy(words, block, BLAKE2B_BLOCK_SIZE);
+    }
+
+    static inline u64 rotr(u64 x, int n) {
+        return (x >> n) | (x << (64 - n));
+    }
+
+    /**
+     * blake2b of a message which fits in its one (and final) block
+     */
+    static void blake2b_one(const u8* input, u64 input_size, u64 output_size, u8* output) {
+        u64 m[16];
+        block_words(input, input_size, m);
+
+        u64 h[8];
+        std::memcpy(h, IV, sizeof(h));
+        h[0] ^= 0x01010000 ^ output_size;
+
+        u64 v[16];
+        std::memcpy(v, h, sizeof(h));
+        std::memcpy(v + 8, IV, sizeof(IV));
+        v[12] ^= input_size;
+        v[14] = ~v[14];
+
+        auto g = [&](int a, int b, int c, int d, u64 x, u64 y) {
+            v[a] = v[a] + v[b] + x;
+            v[d] = rotr(v[d] ^ v[a], 32);
+            v[c] = v[c] + v[d];
+            v[b] = rotr(v[b] ^ v[c], 24);
+            v[a] = v[a] + v[b] + y;
+            v[d] = rotr(v[d] ^ v[a], 16);
+            v[c] = v[c] + v[d];
+            v[b] = rotr(v[b] ^ v[c], 63);
+        };
+        for (auto r = 0; r < 12; r++) {
+            const u8* s = SIGMA[r];
+            g(0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+            g(1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+            g(2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+            g(3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+            g(0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+            g(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            g(2, 7,  8, 13, m[s[12]], m[s[13]]);
+            g(3, 4,  9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (auto i = 0; i < 8; i++) { h[i] ^= v[i] ^ v[i + 8]; }
+        std::memcpy(output, h, output_size);
+    }
+
+#if defined(__x86_64__)
+    /**
+     * blake2b_one for BLAKE2B_LANES messages at once, each state word
+     *  holding that word of every message in its own 64 bit lane
+     */
+    __attribute__((target("avx2")))
+    static void blake2b_lanes(const u8* inputs, u64 input_size, u64 output_size, u8* outputs) {
+        // message words transposed so word j of every lane loads together
+        alignas(32) u64 words[16][BLAKE2B_LANES];
+        for (auto lane = 0; lane < BLAKE2B_LANES; lane++) {
+            u64 m[16];
+            block_words(inputs + lane * input_size, input_size, m);
+            for (auto j = 0; j < 16; j++) { words[j][lane] = m[j]; }
+        }
+        __m256i m[16];
+        for (auto j = 0; j < 16; j++) { m[j] = _mm256_load_si256((const __m256i*) words[j]); }
+
+        const __m256i rotate16 = _mm256_setr_epi8(
+            2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+            2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9
+        );
+        const __m256i rotate24 = _mm256_setr_epi8(
+            3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+            3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10
+        );
+
+        __m256i h[8], v[16];
+        for (auto i = 0; i < 8; i++) { h[i] = _mm256_set1_epi64x(IV[i]); }
+        h[0] = _mm256_xor_si256(h[0], _mm256_set1_epi64x(0x01010000 ^ output_size));
+        for (auto i = 0; i < 8; i++) {
+            v[i] = h[i];
+            v[i + 8] = _mm256_set1_epi64x(IV[i]);
+        }
+        v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x(input_size));
+        v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x(-1));
+
+        // a lambda wouldn't inherit the avx2 target, so the mixing is a macro
+#define LANES_G(a, b, c, d, x, y) do {                                                      \
+            v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), x);                       \
+            v[d] = _mm256_shuffle_epi32(_mm256_xor_si256(v[d], v[a]), _MM_SHUFFLE(2, 3, 0, 1)); \
+            v[c] = _mm256_add_epi64(v[c], v[d]);                                             \
+            v[b] = _mm256_shuffle_epi8(_mm256_xor_si256(v[b], v[c]), rotate24);              \
+            v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), y);                       \
+            v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), rotate16);              \
+            v[c] = _mm256_add_epi64(v[c], v[d]);                                             \
+            __m256i t = _mm256_xor_si256(v[b], v[c]);                                        \
+            v[b] = _mm256_or_si256(_mm256_srli_epi64(t, 63), _mm256_add_epi64(t, t));        \
+        } while (0)
+
+        for (auto r = 0; r < 12; r++) {
+            const u8* s = SIGMA[r];
+            LANES_G(0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+            LANES_G(1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+            LANES_G(2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+            LANES_G(3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+            LANES_G(0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+            LANES_G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            LANES_G(2, 7,  8, 13, m[s[12]], m[s[13]]);
+            LANES_G(3, 4,  9, 14, m[s[14]], m[s[15]]);
+        }
+#undef LANES_G
+
+        // transpose back into one digest per lane
+        alignas(32) u64 state[8][BLAKE2B_LANES];
+        for (auto i = 0; i < 8; i++) {
+            h[i] = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+            _mm256_store_si256((__m256i*) state[i], h[i]);
+        }
+        for (auto lane = 0; lane < BLAKE2B_LANES; lane++) {
+            u64 digest[8];
+            for (auto i = 0; i < 8; i++) { digest[i] = state[i][lane]; }
+            std::memcpy(outputs + lane * output_size, digest, output_size);
+        }
+    }
+#endif
+
+    void blake2b_many(const u8* inputs, u64 input_size, u64 count, u64 output_size, u8* outputs) {
+        if (input_size > BLAKE2B_BLOCK_SIZE || output_size == 0 || output_size > BLAKE2B_MAX_DIGEST) {
+            throw std::runtime_error("blake2b_many only hashes single blocks into at most 64 bytes");
+        }
+
+        u64 i = 0;
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("avx2")) {
+            for (; i + BLAKE2B_LANES <= count; i += BLAKE2B_LANES) {
+                blake2b_lanes(inputs + i * input_size, input_size, output_size, outputs + i * output_size);
+            }
+        }
+#endif
+
+        // whatever is left over (or everything without avx2)
+        for (; i < count; i++) {
+            blake2b_one(inputs + i * input_size, input_size, output_size, outputs + i * output_size);
+        }
+    }
+}
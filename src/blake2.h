@@ -0,0 +1,28 @@
+#pragma once
+
+#include "defines.h"
+
+// # of messages hashed together in the lanes of one simd compression
+#define BLAKE2B_LANES 4
+
+// largest message hashed by blake2b_many (a single blake2b block)
+#define BLAKE2B_BLOCK_SIZE 128
+
+// largest digest blake2b produces
+#define BLAKE2B_MAX_DIGEST 64
+
+namespace unbalanced_psi {
+
+    /**
+     * unkeyed blake2b of many short messages, BLAKE2B_LANES at a time with
+     *  avx2 where the cpu has it, giving the same digests as hashing each
+     *  message on its own
+     *
+     * @params <inputs> the messages, back to back
+     * @params <input_size> bytes in each message (at most BLAKE2B_BLOCK_SIZE)
+     * @params <count> number of messages
+     * @params <output_size> bytes in each digest (at most BLAKE2B_MAX_DIGEST)
+     * @params <outputs> where to put the <count> * <output_size> bytes
+     */
+    void blake2b_many(const u8* inputs, u64 input_size, u64 count, u64 output_size, u8* outputs);
+}
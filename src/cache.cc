@@ -0,0 +1,395 @@
+#include "cache.h"
+
+#include <cstdio>
+#include <random>
+#include <sys/stat.h>
+
+#include <cryptoTools/Crypto/RandomOracle.h>
+
+#define CACHE_MAGIC u64(0x4548434143495350) // "PSICACHE"
+#define CACHE_VERSION u64(3)
+#define EPOCH_MAGIC u64(0x48434f5045495350) // "PSIEPOCH"
+#define RESULTS_MAGIC u64(0x53544c5352495350) // "PSIRSLTS"
+
+namespace unbalanced_psi {
+
+    using RandomOracle = osuCrypto::RandomOracle;
+
+    OfflineCache::OfflineCache(string directory, string key_file) :
+        filename(directory + "/" + CACHE_FILENAME),
+        key_filename(key_file.empty() ? directory + "/" + CACHE_KEY_FILENAME : key_file),
+        epoch_filename(directory + "/" + CACHE_EPOCH_FILENAME) { }
+
+    cache_digest OfflineCache::digest(const vector<INPUT_TYPE>& dataset, const PSIParams& params, u64 epoch) {
+        // threads are left out since they don't change the artifacts
+        u64 fields[] = {
+            CACHE_VERSION, params.entry_size, params.compact,
+            params.cuckoo_size, params.cuckoo_hashes, params.hashtable_size
+        };
+
+        RandomOracle oracle(CACHE_DIGEST_SIZE);
+        oracle.Update((const u8*) fields, sizeof(fields));
+        oracle.Update((const u8*) dataset.data(), dataset.size() * sizeof(INPUT_TYPE));
+
+        // artifacts from another epoch are under another key
+        if (epoch != 0) { oracle.Update((const u8*) &epoch, sizeof(u64)); }
+
+        cache_digest output;
+        oracle.Final(output.data());
+        return output;
+    }
+
+    bool OfflineCache::load(const cache_digest& digest, Number& key, vector<Hashtable>& tables) {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file) { return false; }
+
+        u64 magic, version;
+        cache_digest cached;
+        file.read((char*) &magic, sizeof(u64));
+        file.read((char*) &version, sizeof(u64));
+        file.read((char*) cached.data(), cached.size());
+        if (!file || magic != CACHE_MAGIC || version != CACHE_VERSION || cached != digest) {
+            return false;
+        }
+
+        block nonce;
+        Number sealed;
+        cache_digest expected;
+        file.read((char*) &nonce, sizeof(block));
+        file.read((char*) sealed.data(), sealed.size());
+        file.read((char*) expected.data(), expected.size());
+        if (!file) { return false; }
+
+        // whatever is left of the file bounds every size read from it
+        //  before anything is allocated
+        auto start = file.tellg();
+        file.seekg(0, std::ios::end);
+        u64 remaining = u64(file.tellg() - start);
+        file.seekg(start);
+
+        u64 count;
+        file.read((char*) &count, sizeof(u64));
+        if (!file || count > remaining / (4 * sizeof(u64))) { return false; }
+        remaining -= sizeof(u64);
+
+        vector<Hashtable> loaded;
+        for (auto i = 0; i < count; i++) {
+            u64 buckets, width, size, compact;
+            file.read((char*) &buckets, sizeof(u64));
+            file.read((char*) &width, sizeof(u64));
+            file.read((char*) &size, sizeof(u64));
+            file.read((char*) &compact, sizeof(u64));
+            if (!file || remaining < 4 * sizeof(u64)) { return false; }
+            remaining -= 4 * sizeof(u64);
+            if (buckets == 0 || width + sizeof(u64) > remaining / buckets) { return false; }
+            remaining -= buckets * (width + sizeof(u64));
+
+            Hashtable hashtable(buckets, compact);
+            hashtable.width = width;
+            hashtable.size = size;
+            hashtable.padded = true;
+            for (auto j = 0; j < buckets; j++) {
+                hashtable.table[j].resize(width);
+                file.read((char*) hashtable.table[j].data(), width);
+            }
+            // kept so the tables can be updated in place later
+            file.read((char*) hashtable.occupancy.data(), buckets * sizeof(u64));
+            loaded.push_back(std::move(hashtable));
+        }
+        if (!file) { return false; }
+
+        // refuse artifacts that weren't sealed with our local key
+        auto sealing = sealing_key();
+        if (tag(sealing, contents(digest, loaded), nonce, sealed) != expected) {
+            throw std::runtime_error("offline cache " + filename + " failed authentication");
+        }
+
+        auto mask = pad(sealing, nonce);
+        for (auto i = 0; i < key.size(); i++) {
+            key[i] = sealed[i] ^ mask[i];
+        }
+        tables = std::move(loaded);
+        return true;
+    }
+
+    void OfflineCache::store(const cache_digest& digest, const Number& key, const vector<Hashtable>& tables) {
+        auto sealing = sealing_key();
+
+        // fresh nonce so re-sealing for the same inputs never reuses a pad
+        block nonce = fresh_nonce();
+
+        Number sealed;
+        auto mask = pad(sealing, nonce);
+        for (auto i = 0; i < key.size(); i++) {
+            sealed[i] = key[i] ^ mask[i];
+        }
+        auto authentication = tag(sealing, contents(digest, tables), nonce, sealed);
+
+        // write to the side so an interrupted run can't leave a torn cache
+        string partial = filename + ".partial";
+        std::ofstream file(partial, std::ios::out | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + partial); }
+
+        u64 header[] = { CACHE_MAGIC, CACHE_VERSION };
+        file.write((const char*) header, sizeof(header));
+        file.write((const char*) digest.data(), digest.size());
+        file.write((const char*) &nonce, sizeof(block));
+        file.write((const char*) sealed.data(), sealed.size());
+        file.write((const char*) authentication.data(), authentication.size());
+
+        u64 count = tables.size();
+        file.write((const char*) &count, sizeof(u64));
+        for (const auto& hashtable : tables) {
+            u64 buckets = hashtable.table.size();
+            file.write((const char*) &buckets, sizeof(u64));
+            file.write((const char*) &hashtable.width, sizeof(u64));
+            file.write((const char*) &hashtable.size, sizeof(u64));
+            u64 compact = hashtable.compact;
+            file.write((const char*) &compact, sizeof(u64));
+            for (auto j = 0; j < buckets; j++) {
+                file.write((const char*) hashtable.table[j].data(), hashtable.width);
+            }
+            file.write((const char*) hashtable.occupancy.data(), buckets * sizeof(u64));
+        }
+        file.close();
+        if (!file) { throw std::runtime_error("failed writing " + partial); }
+
+        if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("cannot replace " + filename);
+        }
+    }
+
+    u64 OfflineCache::epoch(Number& key, bool rotate) {
+        auto sealing = sealing_key();
+
+        u64 current = 0;
+        std::ifstream existing(epoch_filename, std::ios::in | std::ios::binary);
+        if (existing) {
+            u64 magic;
+            block nonce;
+            Number sealed;
+            cache_digest expected;
+            existing.read((char*) &magic, sizeof(u64));
+            existing.read((char*) &current, sizeof(u64));
+            existing.read((char*) &nonce, sizeof(block));
+            existing.read((char*) sealed.data(), sealed.size());
+            existing.read((char*) expected.data(), expected.size());
+            if (!existing || magic != EPOCH_MAGIC) {
+                throw std::runtime_error("malformed key epoch " + epoch_filename);
+            }
+            if (tag(sealing, epoch_digest(current), nonce, sealed) != expected) {
+                throw std::runtime_error("key epoch " + epoch_filename + " failed authentication");
+            }
+
+            if (!rotate) {
+                auto mask = pad(sealing, nonce);
+                for (auto i = 0; i < key.size(); i++) {
+                    key[i] = sealed[i] ^ mask[i];
+                }
+                return current;
+            }
+        }
+
+        // start a new epoch under a new key
+        current = fresh_epoch(current);
+        Point::MakeRandomNonzeroScalar(key);
+
+        block nonce = fresh_nonce();
+        Number sealed;
+        auto mask = pad(sealing, nonce);
+        for (auto i = 0; i < key.size(); i++) {
+            sealed[i] = key[i] ^ mask[i];
+        }
+        auto authentication = tag(sealing, epoch_digest(current), nonce, sealed);
+
+        string partial = epoch_filename + ".partial";
+        std::ofstream file(partial, std::ios::out | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + partial); }
+
+        u64 header[] = { EPOCH_MAGIC, current };
+        file.write((const char*) header, sizeof(header));
+        file.write((const char*) &nonce, sizeof(block));
+        file.write((const char*) sealed.data(), sealed.size());
+        file.write((const char*) authentication.data(), authentication.size());
+        file.close();
+        if (!file) { throw std::runtime_error("failed writing " + partial); }
+
+        if (std::rename(partial.c_str(), epoch_filename.c_str()) != 0) {
+            throw std::runtime_error("cannot replace " + epoch_filename);
+        }
+        return current;
+    }
+
+    array<u8, CACHE_SEALING_KEY_SIZE> OfflineCache::sealing_key() {
+        array<u8, CACHE_SEALING_KEY_SIZE> sealing;
+
+        std::ifstream existing(key_filename, std::ios::in | std::ios::binary);
+        if (existing) {
+            existing.read((char*) sealing.data(), sealing.size());
+            if (!existing) { throw std::runtime_error("malformed sealing key " + key_filename); }
+            return sealing;
+        }
+
+        std::random_device device;
+        for (auto i = 0; i < sealing.size(); i++) {
+            sealing[i] = u8(device());
+        }
+        write_dataset(sealing.data(), sealing.size(), key_filename);
+        chmod(key_filename.c_str(), S_IRUSR | S_IWUSR);
+        return sealing;
+    }
+
+    block OfflineCache::fresh_nonce() {
+        std::random_device device;
+        return block(
+            (u64(device()) << 32) | device(),
+            (u64(device()) << 32) | device()
+        );
+    }
+
+    u64 OfflineCache::fresh_epoch(u64 previous) {
+        std::random_device device;
+        u64 id;
+        do {
+            id = (u64(device()) << 32) | device();
+        } while (id == 0 || id == previous);
+        return id;
+    }
+
+    cache_digest OfflineCache::epoch_digest(u64 epoch) {
+        u64 fields[] = { EPOCH_MAGIC, epoch };
+
+        RandomOracle oracle(CACHE_DIGEST_SIZE);
+        oracle.Update((const u8*) fields, sizeof(fields));
+
+        cache_digest output;
+        oracle.Final(output.data());
+        return output;
+    }
+
+    Number OfflineCache::pad(const array<u8, CACHE_SEALING_KEY_SIZE>& sealing, const block& nonce) {
+        RandomOracle oracle(std::tuple_size<Number>::value);
+        oracle.Update(sealing.data(), sealing.size());
+        oracle.Update((const u8*) &nonce, sizeof(block));
+
+        Number output;
+        oracle.Final(output.data());
+        return output;
+    }
+
+    cache_digest OfflineCache::contents(const cache_digest& digest, const vector<Hashtable>& tables) {
+        RandomOracle oracle(CACHE_DIGEST_SIZE);
+        oracle.Update(digest.data(), digest.size());
+        for (const auto& hashtable : tables) {
+            u64 fields[] = { hashtable.table.size(), hashtable.width, hashtable.size, hashtable.compact };
+            oracle.Update((const u8*) fields, sizeof(fields));
+            for (const auto& bucket : hashtable.table) {
+                oracle.Update(bucket.data(), bucket.size());
+            }
+            oracle.Update((const u8*) hashtable.occupancy.data(), hashtable.occupancy.size() * sizeof(u64));
+        }
+
+        cache_digest output;
+        oracle.Final(output.data());
+        return output;
+    }
+
+    cache_digest OfflineCache::tag(
+        const array<u8, CACHE_SEALING_KEY_SIZE>& sealing,
+        const cache_digest& digest,
+        const block& nonce,
+        const Number& sealed
+    ) {
+        // domain separate from the pad, which also starts with the sealing key
+        u8 domain = 1;
+        RandomOracle oracle(CACHE_DIGEST_SIZE);
+        oracle.Update(sealing.data(), sealing.size());
+        oracle.Update(&domain, 1);
+        oracle.Update(digest.data(), digest.size());
+        oracle.Update((const u8*) &nonce, sizeof(block));
+        oracle.Update(sealed.data(), sealed.size());
+
+        cache_digest output;
+        oracle.Final(output.data());
+        return output;
+    }
+
+    ResultCache::ResultCache(string name, u64 size) :
+        filename(name), entry_size(size) {
+
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file) { return; }
+
+        u64 magic, epoch, stored_size, count;
+        file.read((char*) &magic, sizeof(u64));
+        file.read((char*) &epoch, sizeof(u64));
+        file.read((char*) &stored_size, sizeof(u64));
+        file.read((char*) &count, sizeof(u64));
+        if (!file || magic != RESULTS_MAGIC) {
+            throw std::runtime_error("malformed result cache " + filename);
+        }
+        if (stored_size != entry_size) { return; }
+
+        // the count is only trusted as far as the file can back it up
+        auto start = file.tellg();
+        file.seekg(0, std::ios::end);
+        u64 remaining = u64(file.tellg() - start);
+        file.seekg(start);
+        if (count > remaining / (sizeof(INPUT_TYPE) + entry_size)) {
+            throw std::runtime_error("truncated result cache " + filename);
+        }
+
+        results.reserve(count);
+        for (auto i = 0; i < count; i++) {
+            INPUT_TYPE item;
+            hash_type result(entry_size);
+            file.read((char*) &item, sizeof(INPUT_TYPE));
+            file.read((char*) result.data(), entry_size);
+            if (!file) { throw std::runtime_error("truncated result cache " + filename); }
+            results.emplace(item, std::move(result));
+        }
+        current = epoch;
+    }
+
+    u64 ResultCache::epoch() {
+        return current;
+    }
+
+    void ResultCache::rotate(u64 epoch) {
+        if (epoch == current) { return; }
+        current = epoch;
+        results.clear();
+    }
+
+    const hash_type* ResultCache::find(INPUT_TYPE item) {
+        auto match = results.find(item);
+        return match == results.end() ? nullptr : &match->second;
+    }
+
+    void ResultCache::insert(INPUT_TYPE item, const hash_type& result) {
+        results[item] = result;
+    }
+
+    u64 ResultCache::size() {
+        return results.size();
+    }
+
+    void ResultCache::to_file() {
+        string partial = filename + ".partial";
+        std::ofstream file(partial, std::ios::out | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + partial); }
+
+        u64 header[] = { RESULTS_MAGIC, current, entry_size, results.size() };
+        file.write((const char*) header, sizeof(header));
+        for (auto& [ item, result ] : results) {
+            file.write((const char*) &item, sizeof(INPUT_TYPE));
+            file.write((const char*) result.data(), entry_size);
+        }
+        file.close();
+        if (!file) { throw std::runtime_error("failed writing " + partial); }
+
+        if (std::rename(partial.c_str(), filename.c_str()) != 0) {
+            throw std::runtime_error("cannot replace " + filename);
+        }
+    }
+}
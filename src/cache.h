@@ -0,0 +1,187 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "defines.h"
+#include "hashtable.h"
+#include "utils.h"
+
+#define CACHE_FILENAME "offline.cache"
+#define CACHE_KEY_FILENAME "sealing.key"
+#define CACHE_EPOCH_FILENAME "epoch.key"
+
+#define CLIENT_RESULT_CACHE "out/client.results"
+
+// # of bytes in the digest of the server's inputs
+#define CACHE_DIGEST_SIZE 32
+
+// # of bytes in the local key used to seal the server's secret key
+#define CACHE_SEALING_KEY_SIZE 32
+
+namespace unbalanced_psi {
+
+    using cache_digest = array<u8, CACHE_DIGEST_SIZE>;
+
+    /**
+     * persists the server's secret key and binned tables between runs so
+     *  restarts on an unchanged dataset don't redo every scalar multiplication
+     */
+    class OfflineCache {
+
+        // file holding the cached artifacts
+        string filename;
+
+        // file holding the local key which seals the server's secret key
+        string key_filename;
+
+        // file holding the secret key of the current key epoch
+        string epoch_filename;
+
+        public:
+
+        /**
+         * setup cache in a directory
+         *
+         * @params <directory> where to keep the cached artifacts
+         * @params <key_file> local sealing key (created if it doesn't exist),
+         *                    defaults to a file inside of <directory>
+         */
+        OfflineCache(string directory, string key_file = "");
+
+        /**
+         * digest of everything the offline artifacts depend on
+         *
+         * @params <dataset> server's dataset
+         * @params <params> parameters for psi protocol
+         * @params <epoch> id of the key epoch the artifacts are under (0 if none)
+         */
+        static cache_digest digest(const vector<INPUT_TYPE>& dataset, const PSIParams& params, u64 epoch = 0);
+
+        /**
+         * load cached artifacts if they were produced from the same inputs
+         *
+         * @params <digest> digest of the current inputs
+         * @params <key> set to the cached secret key on success
+         * @params <tables> set to the cached hashtables on success
+         * @return whether the cache could be used
+         */
+        bool load(const cache_digest& digest, Number& key, vector<Hashtable>& tables);
+
+        /**
+         * overwrite the cache with newly computed artifacts
+         */
+        void store(const cache_digest& digest, const Number& key, const vector<Hashtable>& tables);
+
+        /**
+         * secret key of the current key epoch, which outlives changes to the
+         *  dataset so clients can keep the oprf outputs they got under it
+         *
+         * @params <key> set to the secret key of the epoch
+         * @params <rotate> start a new epoch under a freshly sampled key
+         * @return id of the epoch, random (and never 0) so that epochs of
+         *         other servers or of a lost epoch file can't be confused
+         *         with this one
+         */
+        u64 epoch(Number& key, bool rotate = false);
+
+        private:
+
+        /**
+         * read the local sealing key, generating a new one if it doesn't exist
+         */
+        array<u8, CACHE_SEALING_KEY_SIZE> sealing_key();
+
+        /**
+         * random nonce, fresh for every sealing of a secret key
+         */
+        static block fresh_nonce();
+
+        /**
+         * random id for a new key epoch, neither 0 nor <previous>
+         */
+        static u64 fresh_epoch(u64 previous);
+
+        /**
+         * stands in for the digest of the inputs when sealing an epoch's key
+         */
+        static cache_digest epoch_digest(u64 epoch);
+
+        /**
+         * digest of the inputs together with every byte of the tables, so
+         *  the tag covers the tables as well as the secret key
+         */
+        static cache_digest contents(const cache_digest& digest, const vector<Hashtable>& tables);
+
+        /**
+         * one-time pad and authentication tag for sealing the secret key
+         */
+        Number pad(const array<u8, CACHE_SEALING_KEY_SIZE>& sealing, const block& nonce);
+        cache_digest tag(
+            const array<u8, CACHE_SEALING_KEY_SIZE>& sealing,
+            const cache_digest& digest,
+            const block& nonce,
+            const Number& sealed
+        );
+    };
+
+    /**
+     * the client's oprf outputs from earlier runs, kept for as long as the
+     *  server stays in the same key epoch so repeated items needn't be
+     *  queried again
+     */
+    class ResultCache {
+
+        // file holding the cached outputs
+        string filename;
+
+        // number of bytes in each oprf output
+        u64 entry_size;
+
+        // id of the server's key epoch the outputs were computed under (0 if none)
+        u64 current = 0;
+
+        // oprf output of each item queried under the current epoch
+        std::unordered_map<INPUT_TYPE, hash_type> results;
+
+        public:
+
+        /**
+         * read the cache from file, starting out empty if there is none or
+         *  it holds outputs of a different size
+         *
+         * @params <filename> where to keep the cached outputs
+         * @params <entry_size> number of bytes in each oprf output
+         */
+        ResultCache(string filename, u64 entry_size);
+
+        /**
+         * id of the key epoch the cached outputs are under
+         */
+        u64 epoch();
+
+        /**
+         * move to a new key epoch, dropping the outputs of the old one
+         */
+        void rotate(u64 epoch);
+
+        /**
+         * cached oprf output of <item>, or nullptr if it has none
+         */
+        const hash_type* find(INPUT_TYPE item);
+
+        /**
+         * add the oprf output of <item> under the current epoch
+         */
+        void insert(INPUT_TYPE item, const hash_type& result);
+
+        /**
+         * number of cached outputs
+         */
+        u64 size();
+
+        /**
+         * overwrite the file with the cached outputs
+         */
+        void to_file();
+    };
+}
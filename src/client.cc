@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iterator>
+#include <limits>
 #include <ostream>
 #include <optional>
 #include <vector>
@@ -18,66 +19,245 @@ namespace unbalanced_psi {
     Client::Client(std::string filename, PSIParams& p) :
         dataset(read_dataset<INPUT_TYPE>(filename)), params(p) {}
 
+    void Client::reuse(ResultCache& c) {
+        cache = &c;
+    }
+
     void Client::offline() {
+        Phase encryption("client.offline.compute");
+        MemoryPhase memory("client.offline.memory");
+        Metrics::global().bytes("client.offline.dataset_bytes", dataset.size() * sizeof(INPUT_TYPE));
+
         // sample a random secret key
         Point::MakeRandomNonzeroScalar(key);
 
-        // calculate the encrypted group element for each input
+        // guess that the server is still in the epoch we last saw
+        blind(cache ? cache->epoch() : 0);
+        Metrics::global().bytes("client.offline.encrypted_bytes", encrypted.size() * sizeof(Point));
+    }
+
+    void Client::blind(u64 under) {
+        pending.clear();
+        vector<INPUT_TYPE> items;
         for (auto i = 0; i < dataset.size(); i++) {
-            auto point = hash_to_group_element(dataset[i]); // h(y)
-            point.scalar_multiply(key, false);              // h(y)^b
-            encrypted.push_back(point);
+            if (under != 0 && cache && cache->find(dataset[i])) { continue; }
+            pending.push_back(i);
+            items.push_back(dataset[i]);
+        }
+        Metrics::global().count("client.offline.cached", dataset.size() - pending.size());
+
+        // calculate the encrypted group element for each input
+        encrypted.resize(items.size());
+        hash_to_group_elements(items.data(), items.size(), encrypted.data()); // h(y)
+        for (auto& point : encrypted) {
+            point.scalar_multiply(key, false);                                // h(y)^b
         }
     }
 
-    tuple<vector<hash_type>, vector<u64>> Client::online(Channel channel) {
+    void Client::announce(u64 announced) {
+        epoch = announced;
+        if (!cache) { return; }
 
-        // send encrypted dataset
-        vector<u8> request(encrypted.size() * Point::save_size);
-        auto iter = request.data();
-        for (Point element : encrypted) {
-            element.save(Point::point_save_span_type{iter, Point::save_size});
-            iter += Point::save_size;
+        // the outputs skipped in offline() are only good under the same key
+        bool usable = epoch != 0 && epoch == cache->epoch();
+        if (!usable && pending.size() != dataset.size()) {
+            Phase encryption("client.online.compute");
+            blind(0);
         }
-        channel.send(request);
+        if (epoch != 0) { cache->rotate(epoch); }
+    }
+
+    tuple<vector<hash_type>, vector<u64>> Client::online(Channel channel) {
+        vector<Channel> channels{channel};
+        return online(channels);
+    }
+
+    tuple<vector<hash_type>, vector<u64>> Client::online(vector<Channel>& channels) {
+        MemoryPhase memory("client.online.memory");
+
+        // which key epoch the server's outputs are under
+        u64 announced;
+        channels[0].recv(&announced, 1);
+        announce(announced);
 
-        // read in doubly-encrypted dataset and replace our `encrypted` with it
-        vector<u8> response(request.size());
-        channel.recv(response);
+        // split encrypted dataset evenly, leaving no channel empty (and
+        //  using none when every item came from the cache)
+        u64 used = std::min<u64>(channels.size(), encrypted.size());
+        u64 batch = used == 0 ? 0 : encrypted.size() / used + (encrypted.size() % used != 0);
+        channels[0].send(&used, 1);
 
         // for decrypting with our secret key
+        Number inverse = inverse_key();
+
+        vector<vector<hash_type>> partials(used);
+        vector<future<void>> futures(used);
+        for (auto i = 0; i < used; i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                u64 begin = std::min<u64>(i * batch, encrypted.size());
+                u64 end = std::min<u64>(begin + batch, encrypted.size());
+
+                // send encrypted dataset
+                vector<u8> request = serialize(begin, end);
+                Phase network("client.online.network");
+                channels[i].send(request);
+
+                // read in doubly-encrypted dataset
+                vector<u8> response(request.size());
+                channels[i].recv(response);
+                network.stop();
+
+                Phase computation("client.online.compute");
+                partials[i] = unblind(response, inverse);
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+
+        return finish(partials);
+    }
+
+    online_task Client::online(coproto::Socket& socket) {
+        MC_BEGIN(online_task, this, &socket,
+            announced = u64{},
+            count = u64{},
+            request = vector<u8>{},
+            response = vector<u8>{},
+            partials = vector<vector<hash_type>>(1)
+        );
+
+        // which key epoch the server's outputs are under
+        MC_AWAIT(socket.recv(announced));
+        announce(announced);
+
+        // how many points follow, since a fully cached dataset sends none
+        count = encrypted.size();
+        MC_AWAIT(socket.send(u64(count)));
+
+        if (count != 0) {
+            // send encrypted dataset
+            request = serialize(0, encrypted.size());
+            response.resize(request.size());
+            MC_AWAIT(socket.send(std::move(request)));
+
+            // read in doubly-encrypted dataset
+            MC_AWAIT(socket.recv(response));
+
+            Phase computation("client.online.compute");
+            partials[0] = unblind(response, inverse_key());
+        }
+        MC_RETURN(finish(partials));
+
+        MC_END();
+    }
+
+    Number Client::inverse_key() {
         Number inverse;
         Point::InvertScalar(key, inverse);
+        return inverse;
+    }
+
+    vector<u8> Client::serialize(u64 begin, u64 end) {
+        vector<u8> request((end - begin) * Point::save_size);
+        auto iter = request.data();
+        for (auto i = begin; i < end; i++) {
+            encrypted[i].save(Point::point_save_span_type{iter, Point::save_size});
+            iter += Point::save_size;
+        }
+        return request;
+    }
+
+    Resolver Client::resolver() {
+        return Resolver(outputs, output_buckets, dataset);
+    }
+
+    tuple<vector<hash_type>, vector<u64>> Client::finish(vector<vector<hash_type>>& partials) {
+        Phase binning("client.binning.compute");
+
+        // outputs of the queried items, in the order they were sent
+        vector<hash_type> fresh;
+        for (auto& partial : partials) {
+            for (auto& result : partial) { fresh.push_back(std::move(result)); }
+        }
+        if (fresh.size() != pending.size()) {
+            throw std::runtime_error("server answered a different number of points than were sent");
+        }
+
+        // the rest come from the cache, which keeps the fresh ones for next time
+        vector<hash_type> results(dataset.size());
+        for (auto i = 0; i < pending.size(); i++) {
+            if (cache && epoch != 0) { cache->insert(dataset[pending[i]], fresh[i]); }
+            results[pending[i]] = std::move(fresh[i]);
+        }
+        if (pending.size() != dataset.size()) {
+            for (auto i = 0; i < dataset.size(); i++) {
+                if (results[i].empty()) { results[i] = *cache->find(dataset[i]); }
+            }
+        }
+        Metrics::global().count("client.online.cached", dataset.size() - pending.size());
+        Metrics::global().bytes(
+            "client.online.result_bytes", results.size() * (sizeof(hash_type) + params.entry_size)
+        );
 
         // calculate oprf result and query pairs
-        vector<hash_type> results;
         vector<u64> queries;
-        for (auto i = 0; i < response.size(); i += Point::save_size) {
-            // oprf result
-            hash_type result(HASH_3_SIZE);
-
-            // parse the group element, decrypt, and hash
-            Point point;
-            point.load(Point::point_save_span_const_type{           // h(y)^ab
-                response.data() + i,
-                Point::save_size
-            });
-            point.scalar_multiply(inverse, false);                  // h(y)^a
-            hash_group_element(point, HASH_3_SIZE, result.data());  // g(h(y)^a)
-
+        for (auto& result : results) {
             // index to use as pir query
             queries.push_back(Hashtable::hash(result, params.hashtable_size));
-            results.push_back(result);
         }
 
-        if (params.cuckoo_size == 1) {
-            return std::make_tuple(results, queries);
-        } else {
+        outputs.clear();
+        outputs.reserve(results.size());
+        for (auto i = 0; i < results.size(); i++) {
+            outputs.push_back(
+                params.compact ? Hashtable::compact_entry(results[i], params.hashtable_size) : results[i]
+            );
+        }
+        output_buckets = queries;
+
+        if (params.cuckoo_size != 1) {
             CuckooVector cuckoo(params);
             for (auto i = 0; i < results.size(); i++) {
                 cuckoo.insert(results[i], queries[i]);
             }
-            return cuckoo.split();
+            std::tie(results, queries) = cuckoo.split();
+        }
+
+        // compare against the same reduced form the server stores
+        if (params.compact) {
+            u64 BLANK_QUERY = std::numeric_limits<u64>::max();
+            for (auto i = 0; i < results.size(); i++) {
+                results[i] = queries[i] == BLANK_QUERY ?
+                    hash_type(Hashtable::stored_size(params), 0) :
+                    Hashtable::compact_entry(results[i], params.hashtable_size);
+            }
+        }
+        return std::make_tuple(results, queries);
+    }
+
+    vector<hash_type> Client::unblind(const vector<u8>& response, const Number& inverse) {
+        u64 size = response.size() / Point::save_size;
+        vector<hash_type> results;
+        results.reserve(size);
+
+        vector<Point> points(HASH_BATCH_SIZE);
+        vector<u8> hashed(HASH_BATCH_SIZE * params.entry_size);
+        for (u64 begin = 0; begin < size; begin += HASH_BATCH_SIZE) {
+            u64 count = std::min<u64>(HASH_BATCH_SIZE, size - begin);
+
+            // parse the group elements and decrypt
+            for (auto i = 0; i < count; i++) {
+                points[i].load(Point::point_save_span_const_type{   // h(y)^ab
+                    response.data() + (begin + i) * Point::save_size,
+                    Point::save_size
+                });
+                points[i].scalar_multiply(inverse, false);          // h(y)^a
+            }
+            hash_group_elements(points.data(), count, params.entry_size, hashed.data()); // g(h(y)^a)
+
+            for (auto i = 0; i < count; i++) {
+                auto iter = hashed.begin() + i * params.entry_size;
+                results.emplace_back(iter, iter + params.entry_size);
+            }
         }
+        return results;
     }
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "defines.h"
+#include "cache.h"
 #include "cuckoo.h"
+#include "resolver.h"
 #include "utils.h"
 
 #define CLIENT_SEED 18
@@ -19,14 +21,33 @@
 
 namespace unbalanced_psi {
 
+    // coroutine producing the oprf results and pir queries (named since the
+    //  coroutine macros can't take a type with commas in it)
+    using online_task = coproto::task<tuple<vector<hash_type>, vector<u64>>>;
+
     class Client {
 
         // client's dataset
         std::vector<INPUT_TYPE> dataset;
 
-        // client's encrypted dataset
+        // client's encrypted dataset, only the items queried online
         vector<Point> encrypted;
 
+        // index into dataset of each item in encrypted
+        vector<u64> pending;
+
+        // oprf outputs from earlier runs (optional)
+        ResultCache* cache = nullptr;
+
+        // key epoch the server announced for this run (0 if none)
+        u64 epoch = 0;
+
+        // oprf output of each item in the form the server stores it
+        vector<hash_type> outputs;
+
+        // bucket of the server's hashtable each output is stored in
+        vector<u64> output_buckets;
+
         // secret key
         Number key;
 
@@ -48,7 +69,14 @@ namespace unbalanced_psi {
         Client(std::string db_file, PSIParams& params);
 
         /**
-         * sample secret key and encrypt dataset
+         * only query the items <cache> has no output for under the server's
+         *  key epoch, and keep the outputs of the rest in it
+         */
+        void reuse(ResultCache& cache);
+
+        /**
+         * sample secret key and encrypt dataset, skipping the items cached
+         *  under the last key epoch seen
          */
         void offline();
 
@@ -59,5 +87,64 @@ namespace unbalanced_psi {
          * @return result of the oprf and query inputs to pir
          */
         tuple<vector<hash_type>, vector<u64>> online(Channel channel);
+
+        /**
+         * same as above but split the encrypted dataset across several
+         *  channels, each sent, received, and decrypted on its own thread
+         *
+         * @params <channels> communication channels with the server
+         * @return result of the oprf and query inputs to pir
+         */
+        tuple<vector<hash_type>, vector<u64>> online(vector<Channel>& channels);
+
+        /**
+         * same as above but as a coroutine, so the networking thread is free
+         *  to make progress on other work while waiting on the server
+         *
+         * @params <socket> coproto connection with the server
+         * @return result of the oprf and query inputs to pir
+         */
+        online_task online(coproto::Socket& socket);
+
+        /**
+         * index from the oprf outputs of the last online() back to the items,
+         *  for resolving the pir results into the intersection
+         */
+        Resolver resolver();
+
+        private:
+
+        /**
+         * encrypt the items without an output cached under <under> (all of
+         *  them if it's 0)
+         */
+        void blind(u64 under);
+
+        /**
+         * take note of the key epoch the server announced, encrypting the
+         *  items that were skipped if the cached outputs don't apply to it
+         */
+        void announce(u64 announced);
+
+        /**
+         * inverse of the secret key, for decrypting the server's response
+         */
+        Number inverse_key();
+
+        /**
+         * serialize encrypted[begin:end] for sending to the server
+         */
+        vector<u8> serialize(u64 begin, u64 end);
+
+        /**
+         * combine the decrypted responses and the cached outputs into oprf
+         *  results and pir queries
+         */
+        tuple<vector<hash_type>, vector<u64>> finish(vector<vector<hash_type>>& partials);
+
+        /**
+         * decrypt and hash the server's response to a slice of the encrypted dataset
+         */
+        vector<hash_type> unblind(const vector<u8>& response, const Number& inverse);
     };
 }
@@ -0,0 +1,225 @@
+#include "coordinator.h"
+
+#include <cstring>
+#include <mutex>
+
+namespace unbalanced_psi {
+
+    vector<u8> pack_outputs(const vector<hash_type>& outputs) {
+        u64 count = outputs.size();
+        vector<u8> packed((const u8*) &count, (const u8*) (&count + 1));
+        for (auto& output : outputs) {
+            packed.insert(packed.end(), output.begin(), output.end());
+        }
+        return packed;
+    }
+
+    vector<hash_type> unpack_outputs(const vector<u8>& packed, u64 entry_size) {
+        // the count must account for exactly what was sent
+        if (packed.size() < sizeof(u64)) {
+            throw std::runtime_error("shard sent truncated outputs");
+        }
+        u64 count;
+        std::memcpy(&count, packed.data(), sizeof(u64));
+        if (count != (packed.size() - sizeof(u64)) / entry_size
+                || (packed.size() - sizeof(u64)) % entry_size != 0) {
+            throw std::runtime_error("shard sent " + std::to_string(packed.size() - sizeof(u64))
+                + " bytes for " + std::to_string(count) + " outputs");
+        }
+
+        vector<hash_type> outputs;
+        outputs.reserve(count);
+        for (auto iter = packed.begin() + sizeof(u64); iter != packed.end(); iter += entry_size) {
+            outputs.emplace_back(iter, iter + entry_size);
+        }
+        return outputs;
+    }
+
+    /**
+     * the hashtables an oprf output goes in
+     */
+    vector<u64> tables_of(const hash_type& output, const PSIParams& params) {
+        return params.cuckoo_size == 1 ?
+            vector<u64>{ 0 } :
+            CuckooTable::indexes(output, params.cuckoo_hashes, params.cuckoo_size);
+    }
+
+    Coordinator::Coordinator(vector<Channel> s, PSIParams& p) : shards(s), params(p) { }
+
+    void Coordinator::offline() {
+        // sample a random secret key and share it with every shard
+        Point::MakeRandomNonzeroScalar(key);
+        for (auto& shard : shards) {
+            shard.send(key.data(), key.size());
+        }
+
+        // each shard sends one batch of outputs per shard, in shard order,
+        //  which are passed on as they arrive so none are held here for long
+        vector<std::mutex> forwarding(shards.size());
+        vector<future<void>> futures(shards.size());
+        for (auto i = 0; i < shards.size(); i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                for (auto j = 0; j < shards.size(); j++) {
+                    vector<u8> packed;
+                    shards[i].recv(packed);
+
+                    std::lock_guard<std::mutex> lock(forwarding[j]);
+                    shards[j].asyncSend(std::move(packed));
+                }
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+    }
+
+    void Coordinator::online(vector<Channel>& all_channels) {
+        // same framing as Server::online(), though the key shared with the
+        //  shards is sampled every run so it belongs to no epoch
+        u64 epoch = 0;
+        all_channels[0].send(&epoch, 1);
+
+        // a client whose items all came from its cache asks for no channels,
+        //  leaving every shard idle
+        u64 used;
+        all_channels[0].recv(&used, 1);
+        if (used > all_channels.size()) {
+            throw std::runtime_error("client asked for " + std::to_string(used) + " of "
+                + std::to_string(all_channels.size()) + " channels");
+        }
+
+        vector<vector<u8>> requests(used);
+        vector<future<void>> futures(used);
+        for (auto i = 0; i < used; i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                all_channels[i].recv(requests[i]);
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+
+        vector<u8> request;
+        for (auto& part : requests) {
+            request.insert(request.end(), part.begin(), part.end());
+        }
+
+        Timer timer("[ server ] oprf online fan-out", BLUE);
+
+        // split the points evenly between shards and let each encrypt its part
+        u64 points = request.size() / Point::save_size;
+        u64 batch = points / shards.size() + (points % shards.size() != 0);
+        vector<u8> response(request.size());
+
+        futures.resize(shards.size());
+        for (auto i = 0; i < shards.size(); i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                u64 begin = std::min<u64>(i * batch, points) * Point::save_size;
+                u64 end = std::min<u64>((i + 1) * batch, points) * Point::save_size;
+
+                // shards announce an epoch like any server, but theirs is the
+                //  coordinator's per-run key rather than one from a cache
+                u64 announced;
+                shards[i].recv(&announced, 1);
+                if (announced != 0) {
+                    throw std::runtime_error("shard " + std::to_string(i)
+                        + " announced key epoch " + std::to_string(announced));
+                }
+
+                // shards with nothing to do are told so, rather than sent nothing
+                u64 busy = end > begin;
+                shards[i].send(&busy, 1);
+                if (!busy) { return; }
+
+                shards[i].send(vector<u8>(request.begin() + begin, request.begin() + end));
+                vector<u8> part(end - begin);
+                shards[i].recv(part);
+                std::copy(part.begin(), part.end(), response.begin() + begin);
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+
+        timer.stop();
+
+        // answer on each channel with the same split the client used
+        auto iter = response.begin();
+        for (auto i = 0; i < used; i++) {
+            vector<u8> part(iter, iter + requests[i].size());
+            iter += requests[i].size();
+            futures[i] = std::async(std::launch::async, [&, i](vector<u8> part) {
+                all_channels[i].send(part);
+            }, std::move(part));
+        }
+        for (auto i = 0; i < used; i++) { futures[i].get(); }
+    }
+
+    Shard::Shard(vector<INPUT_TYPE> dataset, PSIParams& p, u64 i, u64 n, Channel c) :
+        server(dataset, p), index(i), count(n), params(p), coordinator(c) { }
+
+    vector<Hashtable> Shard::offline() {
+        Number key;
+        coordinator.recv(key.data(), key.size());
+
+        Timer offline("[ server ] shard offline", BLUE);
+        auto outputs = server.outputs(key);
+
+        // send each output once to every shard holding one of its hashtables
+        Phase routing("server.offline.network");
+        vector<vector<hash_type>> routed(count);
+        for (auto& output : outputs) {
+            vector<bool> sent(count, false);
+            for (auto table : tables_of(output, params)) {
+                if (sent[table % count]) { continue; }
+                sent[table % count] = true;
+                routed[table % count].push_back(output);
+            }
+        }
+        outputs.clear();
+        for (auto& batch : routed) {
+            coordinator.send(pack_outputs(batch));
+            batch.clear();
+        }
+
+        // then bin what every shard (this one included) sent for ours
+        vector<vector<u8>> received(count);
+        for (auto& packed : received) {
+            coordinator.recv(packed);
+        }
+        routing.stop();
+
+        Phase binning("server.binning.compute");
+        auto owned = tables(index, count, params);
+        vector<Hashtable> hashtables(owned.size(), Hashtable(params.hashtable_size, params.compact));
+        for (auto& packed : received) {
+            for (auto& output : unpack_outputs(packed, params.entry_size)) {
+                for (auto table : tables_of(output, params)) {
+                    if (table % count == index) { hashtables[table / count].insert(output); }
+                }
+            }
+            packed.clear();
+        }
+        for (auto& hashtable : hashtables) {
+            hashtable.pad();
+        }
+        binning.stop();
+        offline.stop();
+        return hashtables;
+    }
+
+    void Shard::online() {
+        // the coordinator uses the same framing as a single-channel client
+        vector<Channel> channels{coordinator};
+        server.online(channels);
+    }
+
+    vector<u64> Shard::tables(u64 index, u64 count, const PSIParams& params) {
+        vector<u64> owned;
+        for (auto table = index; table < params.cuckoo_size; table += count) {
+            owned.push_back(table);
+        }
+        return owned;
+    }
+
+    vector<INPUT_TYPE> Coordinator::slice(const vector<INPUT_TYPE>& dataset, u64 shard, u64 shards) {
+        u64 batch = dataset.size() / shards + (dataset.size() % shards != 0);
+        u64 begin = std::min<u64>(shard * batch, dataset.size());
+        u64 end = std::min<u64>(begin + batch, dataset.size());
+        return vector<INPUT_TYPE>(dataset.begin() + begin, dataset.begin() + end);
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "defines.h"
+#include "hashtable.h"
+#include "server.h"
+#include "utils.h"
+
+#define COORDINATOR_ADDRESS "127.0.0.1:1213"
+#define COORDINATOR_SESSION_PREFIX "shard-"
+
+namespace unbalanced_psi {
+
+    /**
+     * serialize oprf outputs as their count followed by the outputs
+     *  themselves (never empty, so it's always sendable)
+     */
+    vector<u8> pack_outputs(const vector<hash_type>& outputs);
+
+    /**
+     * inverse of pack_outputs(), checking the count against what was sent
+     *
+     * @params <entry_size> number of bytes in each oprf output
+     */
+    vector<hash_type> unpack_outputs(const vector<u8>& packed, u64 entry_size);
+
+    /**
+     * fronts a set of server processes which each hold a share of the
+     *  cuckoo table's hashtables, so no one machine needs the whole database
+     */
+    class Coordinator {
+
+        // one channel to each shard's server
+        vector<Channel> shards;
+
+        // secret key shared by all the shards
+        Number key;
+
+        // parameters for psi protocol
+        PSIParams params;
+
+        public:
+
+        /**
+         * setup coordinator with connections to every shard
+         */
+        Coordinator(vector<Channel> shards, PSIParams& params);
+
+        /**
+         * distribute a fresh secret key to the shards, then pass each shard
+         *  the oprf outputs the others computed for its hashtables
+         */
+        void offline();
+
+        /**
+         * receive the client's request, fan its points out to the shards,
+         *  and return their merged responses to the client
+         *
+         * @params <channels> communication channels with the client
+         */
+        void online(vector<Channel>& channels);
+
+        /**
+         * the part of a dataset belonging to one shard
+         */
+        static vector<INPUT_TYPE> slice(const vector<INPUT_TYPE>& dataset, u64 shard, u64 shards);
+    };
+
+    /**
+     * one of the coordinator's servers, which encrypts its slice of the
+     *  dataset and holds hashtables shard, shard + shards, shard + 2 * shards...
+     */
+    class Shard {
+
+        // server over the shard's slice of the dataset
+        Server server;
+
+        // which shard this is, and of how many
+        u64 index, count;
+
+        // parameters for psi protocol
+        PSIParams params;
+
+        // communication channel with the coordinator
+        Channel coordinator;
+
+        public:
+
+        /**
+         * setup shard <index> of <count>
+         *
+         * @params <dataset> the shard's slice of the server's dataset
+         * @params <coordinator> communication channel with the coordinator
+         */
+        Shard(vector<INPUT_TYPE> dataset, PSIParams& params, u64 index, u64 count, Channel coordinator);
+
+        /**
+         * receive the shared key, encrypt the slice, and swap outputs with
+         *  the other shards through the coordinator
+         *
+         * @return the shard's hashtables, padded, in the order of tables()
+         */
+        vector<Hashtable> offline();
+
+        /**
+         * encrypt the share of the client's points the coordinator sends
+         */
+        void online();
+
+        /**
+         * indexes of the hashtables shard <index> of <count> holds
+         */
+        static vector<u64> tables(u64 index, u64 count, const PSIParams& params);
+    };
+}
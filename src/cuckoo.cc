@@ -1,12 +1,15 @@
 #include "cuckoo.h"
 
+#include <cstring>
 #include <limits>
 
 namespace unbalanced_psi {
 
     u64 cuckoo_hash(const vector<u8>& entry, u64 hash_n, u64 table_size) {
-        // interpret the first eight bytes as the seed to the hash
-        u64 value = *reinterpret_cast<const u64*>(&entry[0]);
+        // interpret the first eight bytes as the seed to the hash (zero
+        //  extending shorter entries)
+        u64 value = 0;
+        std::memcpy(&value, entry.data(), std::min<u64>(entry.size(), sizeof(u64)));
         block seed(hash_n, value);
         PRNG prng(seed);
         return prng.get<u64>() % table_size;
@@ -16,28 +19,37 @@ namespace unbalanced_psi {
      * Cuckoo Table : used by the server
      */
     CuckooTable::CuckooTable(const PSIParams& params) :
-        hashes(params.cuckoo_hashes),
-        table(params.cuckoo_size, Hashtable(params.hashtable_size)) { };
+        table(params.cuckoo_size, Hashtable(params.hashtable_size, params.compact)),
+        hashes(params.cuckoo_hashes) { };
 
-    void CuckooTable::insert(const vector<u8>& entry) {
+    vector<u64> CuckooTable::indexes(const vector<u8>& entry, u64 hashes, u64 table_size) {
         vector<u64> indexes;
         for (auto hash_n = 0; hash_n < hashes; hash_n++) {
-            u64 index = cuckoo_hash(entry, hash_n, table.size());
+            u64 index = cuckoo_hash(entry, hash_n, table_size);
 
             // if we've already added this entry at index, don't do it again
             if (std::find(indexes.begin(), indexes.end(), index) != indexes.end()) {
                 continue;
             }
+            indexes.push_back(index);
+        }
+        return indexes;
+    }
 
+    void CuckooTable::insert(const vector<u8>& entry) {
+        for (auto index : CuckooTable::indexes(entry, hashes, table.size())) {
             table[index].insert(entry);
-            indexes.push_back(index);
         }
     }
 
     void CuckooTable::pad() {
+        Phase padding("cuckoo.pad.compute");
+        u64 width = 0;
         for (auto i = 0; i < table.size(); i++) {
             table[i].pad();
+            width = std::max(width, table[i].width);
         }
+        Metrics::global().bytes("cuckoo.pad.max_width", width);
     }
 
     u64 CuckooTable::buckets() {
@@ -48,8 +60,9 @@ namespace unbalanced_psi {
      * Cuckoo Vector : used by the client
      */
     CuckooVector::CuckooVector(const PSIParams& params) :
-        hashes(params.cuckoo_hashes),
         table(params.cuckoo_size, std::nullopt),
+        hashes(params.cuckoo_hashes),
+        entry_size(params.entry_size),
         random(0, params.cuckoo_hashes - 1) { };
 
     void CuckooVector::insert(const vector<u8>& entry, u64 query) {
@@ -88,7 +101,7 @@ namespace unbalanced_psi {
 
     tuple<vector<hash_type>, vector<u64>> CuckooVector::split() {
         u64 BLANK_QUERY = std::numeric_limits<u64>::max();
-        hash_type BLANK_RESULT = hash_type(HASH_3_SIZE, 0);
+        hash_type BLANK_RESULT = hash_type(entry_size, 0);
 
         vector<hash_type> results;
         vector<u64> queries;
@@ -33,6 +33,12 @@ namespace unbalanced_psi {
          */
         CuckooTable(const PSIParams& params);
 
+        /**
+         * the distinct hashtables entry goes in, i.e. the values of
+         *  cuckoo_hash(entry, i, table_size) for i = 0 to hashes
+         */
+        static vector<u64> indexes(const vector<u8>& entry, u64 hashes, u64 table_size);
+
         /**
          * insert entry into a hashtable for each value of
          *  cuckoo_hash(entry, i, params.cuckoo_size)
@@ -62,6 +68,9 @@ namespace unbalanced_psi {
         // number of hashes to cuckoo hash with
         u64 hashes;
 
+        // number of bytes in each oprf output
+        u64 entry_size;
+
         // uniform randomness to choose hash to evict with
         std::mt19937_64 gen;
         std::uniform_int_distribution<u64> random;
@@ -1,5 +1,9 @@
+#include <random>
+#include <thread>
+
 #include <cryptoTools/Common/CLP.h>
 
+#include "generator.h"
 #include "utils.h"
 
 using namespace unbalanced_psi;
@@ -9,14 +13,26 @@ int main(int argc, char *argv[]) {
     osuCrypto::CLP parser;
 	parser.parse(argc, argv);
 
-    int server_size = parser.isSet("-server-log") ?
-        1 << parser.get<int>("-server-log") :
-        parser.get<int>("-server");
-    int client_size = parser.isSet("-client-log") ?
-        1 << parser.get<int>("-client-log") :
-        parser.get<int>("-client");
+    u64 server_size = parser.isSet("-server-log") ?
+        u64(1) << parser.get<int>("-server-log") :
+        parser.get<u64>("-server");
+    u64 client_size = parser.isSet("-client-log") ?
+        u64(1) << parser.get<int>("-client-log") :
+        parser.get<u64>("-client");
+
+    // same seed and sizes always give the same datasets
+    u64 seed = parser.isSet("-seed") ?
+        parser.get<u64>("-seed") :
+        (u64(std::random_device{}()) << 32) | std::random_device{}();
+    std::clog << "[ datagen] seed " << seed << std::endl;
 
-    auto [server, client] = generate_datasets(server_size, client_size, parser.get<int>("-overlap"));
-    write_dataset<INPUT_TYPE>(server, parser.getOr<std::string>("-server-fn", "out/server.db"));
-    write_dataset<INPUT_TYPE>(client, parser.getOr<std::string>("-client-fn", "out/client.db"));
+    DatasetGenerator generator(
+        server_size, client_size, parser.get<u64>("-overlap"), seed,
+        !parser.isSet("-no-shuffle")
+    );
+    generator.write(
+        parser.getOr<std::string>("-server-fn", "out/server.db"),
+        parser.getOr<std::string>("-client-fn", "out/client.db"),
+        parser.getOr<int>("-threads", std::max(1u, std::thread::hardware_concurrency()))
+    );
 }
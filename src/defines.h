@@ -9,6 +9,9 @@
 #include <cryptoTools/Network/Channel.h>
 #include <cryptoTools/Network/IOService.h>
 
+#include <coproto/coproto.h>
+#include <macoro/thread_pool.h>
+
 #include <apsi/oprf/ecpoint.h>
 #include <gsl/span>
 
@@ -29,6 +32,7 @@ namespace unbalanced_psi {
     // datatypes from osuCrypto
     using u64   = osuCrypto::u64;
     using u32   = osuCrypto::u32;
+    using u16   = osuCrypto::u16;
     using u8    = osuCrypto::u8;
     using block = osuCrypto::block;
 
@@ -0,0 +1,128 @@
+#include "generator.h"
+
+#include <fcntl.h>
+#include <limits>
+#include <unistd.h>
+
+namespace unbalanced_psi {
+
+    /**
+     * splitmix64 finalizer, used as the feistel round function
+     */
+    static u64 mix(u64 value) {
+        value += 0x9E3779B97F4A7C15;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+        return value ^ (value >> 31);
+    }
+
+    Permutation::Permutation(u64 s, u64 seed) : size(s) {
+        u64 bits = 2;
+        while (bits < 64 && (u64(1) << bits) < size) { bits += 2; }
+        half_bits = bits / 2;
+        half_mask = (u64(1) << half_bits) - 1;
+
+        for (auto i = 0; i < FEISTEL_ROUNDS; i++) {
+            keys[i] = mix(seed ^ mix(i));
+        }
+    }
+
+    u64 Permutation::feistel(u64 value) const {
+        u64 left = value >> half_bits;
+        u64 right = value & half_mask;
+        for (auto i = 0; i < FEISTEL_ROUNDS; i++) {
+            u64 next = left ^ (mix(right ^ keys[i]) & half_mask);
+            left = right;
+            right = next;
+        }
+        return (left << half_bits) | right;
+    }
+
+    u64 Permutation::operator()(u64 index) const {
+        // the feistel domain is less than 4x size, so this walks ~4 steps at most on average
+        u64 value = feistel(index);
+        while (value >= size) { value = feistel(value); }
+        return value;
+    }
+
+    DatasetGenerator::DatasetGenerator(u64 s, u64 c, u64 o, u64 seed, bool sh) :
+        server_size(s), client_size(c), overlap(o), shuffle(sh),
+        items(u64(std::numeric_limits<INPUT_TYPE>::max()) + 1, seed),
+        shared(std::max<u64>(s, 1), mix(seed + 1)),
+        order(std::max<u64>(c, 1), mix(seed + 2)) {
+
+        if (overlap > server_size || overlap > client_size) {
+            throw std::runtime_error("overlap is larger than one of the datasets");
+        }
+        if (server_size + client_size - overlap > u64(std::numeric_limits<INPUT_TYPE>::max()) + 1) {
+            throw std::runtime_error("not enough distinct elements for both datasets");
+        }
+    }
+
+    INPUT_TYPE DatasetGenerator::server(u64 index) const {
+        return INPUT_TYPE(items(index));
+    }
+
+    INPUT_TYPE DatasetGenerator::client(u64 index) const {
+        u64 position = shuffle ? order(index) : index;
+        if (position < overlap) {
+            // shared element, which without shuffling are the server's last
+            u64 from = shuffle ? shared(position) : server_size - overlap + position;
+            return INPUT_TYPE(items(from));
+        }
+        return INPUT_TYPE(items(server_size + position - overlap));
+    }
+
+    /**
+     * write <size> elements to a file, each thread taking every <threads>th chunk
+     */
+    template <typename F>
+    static void write_elements(const string& filename, u64 size, int threads, F element) {
+        int file = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) { throw std::runtime_error("cannot open " + filename); }
+        if (ftruncate(file, size * sizeof(INPUT_TYPE)) != 0) {
+            close(file);
+            throw std::runtime_error("cannot resize " + filename);
+        }
+
+        u64 chunks = size / GENERATOR_CHUNK_SIZE + (size % GENERATOR_CHUNK_SIZE != 0);
+        vector<future<void>> futures;
+        for (auto t = 0; t < threads; t++) {
+            futures.push_back(std::async(std::launch::async, [&, t]() {
+                vector<INPUT_TYPE> buffer(GENERATOR_CHUNK_SIZE);
+                for (u64 chunk = t; chunk < chunks; chunk += threads) {
+                    u64 begin = chunk * GENERATOR_CHUNK_SIZE;
+                    u64 end = std::min(begin + GENERATOR_CHUNK_SIZE, size);
+                    for (auto i = begin; i < end; i++) {
+                        buffer[i - begin] = element(i);
+                    }
+
+                    u64 bytes = (end - begin) * sizeof(INPUT_TYPE);
+                    u64 written = 0;
+                    while (written < bytes) {
+                        ssize_t n = pwrite(
+                            file, (const char*) buffer.data() + written,
+                            bytes - written, begin * sizeof(INPUT_TYPE) + written
+                        );
+                        if (n <= 0) { throw std::runtime_error("failed writing " + filename); }
+                        written += n;
+                    }
+                }
+            }));
+        }
+
+        // collect every thread before surfacing a failure
+        std::exception_ptr failure;
+        for (auto& f : futures) {
+            try { f.get(); } catch (...) { failure = std::current_exception(); }
+        }
+        close(file);
+        if (failure) { std::rethrow_exception(failure); }
+    }
+
+    void DatasetGenerator::write(const string& server_filename, const string& client_filename, int threads) const {
+        threads = std::max(threads, 1);
+        write_elements(server_filename, server_size, threads, [this](u64 i) { return server(i); });
+        write_elements(client_filename, client_size, threads, [this](u64 i) { return client(i); });
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "defines.h"
+
+// # of feistel rounds in the permutations behind generated datasets
+#define FEISTEL_ROUNDS 6
+
+// # of elements each thread generates and writes at once
+#define GENERATOR_CHUNK_SIZE u64(1 << 20)
+
+namespace unbalanced_psi {
+
+    /**
+     * keyed pseudorandom permutation of [0, size), built from a feistel
+     *  network over the next even power of two and cycle walking back into range
+     */
+    class Permutation {
+
+        u64 size;
+        u64 half_bits;
+        u64 half_mask;
+        array<u64, FEISTEL_ROUNDS> keys;
+
+        u64 feistel(u64 value) const;
+
+        public:
+
+        Permutation(u64 size, u64 seed);
+
+        u64 operator()(u64 index) const;
+    };
+
+    /**
+     * describes a server and client dataset of distinct elements with exactly
+     *  <overlap> elements in common, where any element can be computed on its
+     *  own so the datasets can be written in parallel without holding them
+     *
+     * the server holds items(0 .. server_size), the client holds <overlap> of
+     *  those followed by items(server_size ..), and shuffling picks which of
+     *  the server's elements are shared and where they sit in the client's
+     */
+    class DatasetGenerator {
+
+        u64 server_size;
+        u64 client_size;
+        u64 overlap;
+        bool shuffle;
+
+        Permutation items;
+        Permutation shared;
+        Permutation order;
+
+        public:
+
+        /**
+         * @params <server_size> number of elements in the server's dataset
+         * @params <client_size> number of elements in the client's dataset
+         * @params <overlap>     exact number of elements shared between the two
+         * @params <seed>        same seed and sizes give the same datasets
+         * @params <shuffle>     randomize the positions of the shared elements
+         */
+        DatasetGenerator(u64 server_size, u64 client_size, u64 overlap, u64 seed, bool shuffle = true);
+
+        INPUT_TYPE server(u64 index) const;
+        INPUT_TYPE client(u64 index) const;
+
+        /**
+         * stream both datasets to binary files, chunk by chunk across threads
+         */
+        void write(const string& server_filename, const string& client_filename, int threads) const;
+    };
+}
@@ -1,13 +1,26 @@
 #include "hashtable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
 #include "utils.h"
 
 namespace unbalanced_psi {
 
-    Hashtable::Hashtable(u64 buckets) :
-        size(0), width(0), table(buckets, vector<u8>()) { }
+    Hashtable::Hashtable(u64 buckets, bool c) :
+        table(buckets, vector<u8>()), width(0), size(0),
+        compact(c), padded(false), occupancy(buckets, 0) { }
 
     u64 Hashtable::hash(const vector<u8>& entry, u64 table_size) {
-        return Hashtable::hash(entry.data(), table_size);
+        if (entry.size() >= sizeof(u64)) {
+            return Hashtable::hash(entry.data(), table_size);
+        }
+
+        // short entries are zero extended
+        u64 value = 0;
+        std::memcpy(&value, entry.data(), entry.size());
+        return value % table_size;
     }
 
     u64 Hashtable::hash(const u8* entry, u64 table_size) {
@@ -16,27 +29,205 @@ namespace unbalanced_psi {
         return value % table_size;
     }
 
-    void Hashtable::insert(const vector<u8>& entry) {
+    u64 Hashtable::compact_size(u64 entry_size, u64 table_size) {
+        u64 prefix = std::min<u64>(entry_size, sizeof(u64));
+        u64 largest = prefix == sizeof(u64) ?
+            std::numeric_limits<u64>::max() : (u64(1) << (8 * prefix)) - 1;
+
+        // bytes needed for the largest quotient, keeping at least one
+        u64 quotient = largest / table_size;
+        u64 bytes = 1;
+        while (bytes < sizeof(u64) && (quotient >> (8 * bytes)) != 0) { bytes++; }
+        return bytes + (entry_size - prefix);
+    }
+
+    u64 Hashtable::stored_size(const PSIParams& params) {
+        return params.compact ?
+            compact_size(params.entry_size, params.hashtable_size) : params.entry_size;
+    }
+
+    vector<u8> Hashtable::compact_entry(const vector<u8>& entry, u64 table_size) {
+        u64 prefix = std::min<u64>(entry.size(), sizeof(u64));
+        u64 bytes = compact_size(entry.size(), table_size) - (entry.size() - prefix);
+
+        u64 value = 0;
+        std::memcpy(&value, entry.data(), prefix);
+        u64 quotient = value / table_size;
+
+        vector<u8> compacted(bytes + entry.size() - prefix);
+        std::memcpy(compacted.data(), &quotient, bytes);
+        std::copy(entry.begin() + prefix, entry.end(), compacted.begin() + bytes);
+        return compacted;
+    }
+
+    vector<u8> Hashtable::expand_entry(const u8* compacted, u64 bucket, u64 entry_size, u64 table_size) {
+        u64 prefix = std::min<u64>(entry_size, sizeof(u64));
+        u64 bytes = compact_size(entry_size, table_size) - (entry_size - prefix);
+
+        u64 quotient = 0;
+        std::memcpy(&quotient, compacted, bytes);
+        u64 value = quotient * table_size + bucket;
+
+        vector<u8> entry(entry_size);
+        std::memcpy(entry.data(), &value, prefix);
+        std::copy(compacted + bytes, compacted + bytes + entry_size - prefix, entry.begin() + prefix);
+        return entry;
+    }
+
+    bool Hashtable::insert(const vector<u8>& entry) {
         u64 index = hash(entry, table.size());
-        table[index].insert(table[index].begin(), entry.begin(), entry.end());
-        if (table[index].size() > width) { width = table[index].size(); }
+        auto stored = compact ? Hashtable::compact_entry(entry, table.size()) : entry;
+
+        // entries sit at the front of the bucket with any padding after them
+        auto& bucket = table[index];
+        u64 spare = bucket.size() - occupancy[index] * stored.size();
+        bucket.insert(bucket.begin(), stored.begin(), stored.end());
+        if (spare >= stored.size()) { bucket.resize(bucket.size() - stored.size()); }
+        occupancy[index]++;
         size++;
+
+        if (bucket.size() <= width) { return false; }
+        width = bucket.size();
+        if (padded) { pad(); }
+        return true;
+    }
+
+    /**
+     * offset of the entry's slot in its bucket, or the bucket's size if it
+     *  isn't there
+     */
+    static u64 find_entry(const vector<u8>& bucket, u64 occupancy, const vector<u8>& stored) {
+        for (u64 slot = 0; slot < occupancy; slot++) {
+            auto begin = bucket.begin() + slot * stored.size();
+            if (std::equal(stored.begin(), stored.end(), begin)) { return slot * stored.size(); }
+        }
+        return bucket.size();
+    }
+
+    bool Hashtable::contains(const vector<u8>& entry) {
+        u64 index = hash(entry, table.size());
+        auto stored = compact ? Hashtable::compact_entry(entry, table.size()) : entry;
+        return find_entry(table[index], occupancy[index], stored) != table[index].size();
+    }
+
+    bool Hashtable::remove(const vector<u8>& entry) {
+        u64 index = hash(entry, table.size());
+        auto stored = compact ? Hashtable::compact_entry(entry, table.size()) : entry;
+
+        auto& bucket = table[index];
+        u64 offset = find_entry(bucket, occupancy[index], stored);
+        if (offset == bucket.size()) { return false; }
+
+        bucket.erase(bucket.begin() + offset, bucket.begin() + offset + stored.size());
+        if (padded) { bucket.resize(width); }
+        occupancy[index]--;
+        size--;
+        return true;
+    }
+
+    void Hashtable::merge(const Hashtable& other) {
+        if (other.table.size() != table.size()) {
+            throw std::runtime_error("cannot merge hashtables with different numbers of buckets");
+        }
+        for (auto i = 0; i < table.size(); i++) {
+            table[i].insert(table[i].end(), other.table[i].begin(), other.table[i].end());
+            occupancy[i] += other.occupancy[i];
+            if (table[i].size() > width) { width = table[i].size(); }
+        }
+        size += other.size;
     }
 
     void Hashtable::pad() {
+        Phase padding("hashtable.pad.compute");
+        u64 added = 0;
         for (auto i = 0; i < table.size(); i++) {
+            added += width - table[i].size();
             table[i].resize(width);
         }
+        padded = true;
+        Metrics::global().count("hashtable.pad.bytes", added);
     }
 
-    void Hashtable::to_file(string filename) {
+    void Hashtable::to_file(string filename, u64 entry_size) {
+        Phase writing("hashtable.write.disk");
         std::ofstream file(filename, std::ios::out | std::ios::binary);
         if (!file) { throw std::runtime_error("cannot open " + filename); }
-        file.write((const char*) &width, sizeof(u64));
-        for (auto i = 0; i < table.size(); i++) {
-            file.write((const char*) table[i].data(), table[i].size());
+
+        u64 written;
+        if (entry_size == 0) {
+            file.write((const char*) &width, sizeof(u64));
+            written = sizeof(u64);
+            for (auto i = 0; i < table.size(); i++) {
+                file.write((const char*) table[i].data(), table[i].size());
+                written += table[i].size();
+            }
+        } else {
+            u64 header[] = { HASHTABLE_SPARSE_MAGIC, width, table.size(), entry_size, compact };
+            file.write((const char*) header, sizeof(header));
+
+            vector<u32> lengths(table.size());
+            for (auto i = 0; i < table.size(); i++) { lengths[i] = occupancy[i]; }
+            file.write((const char*) lengths.data(), lengths.size() * sizeof(u32));
+            written = sizeof(header) + lengths.size() * sizeof(u32);
+
+            // entries sit at the front of each bucket, padding after them
+            for (auto i = 0; i < table.size(); i++) {
+                file.write((const char*) table[i].data(), occupancy[i] * entry_size);
+                written += occupancy[i] * entry_size;
+            }
         }
         file.close();
+        Metrics::global().count("hashtable.write.bytes", written);
+    }
+
+    Hashtable Hashtable::from_file(string filename) {
+        Phase reading("hashtable.read.disk");
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+
+        file.seekg(0, std::ios::end);
+        u64 remaining = file.tellg();
+        file.seekg(0);
+
+        u64 header[5];
+        file.read((char*) header, sizeof(header));
+        if (!file || header[0] != HASHTABLE_SPARSE_MAGIC) {
+            throw std::runtime_error(filename + " isn't a sparse hashtable file");
+        }
+        u64 width = header[1], buckets = header[2], entry_size = header[3];
+        remaining -= sizeof(header);
+        if (buckets > remaining / sizeof(u32) || entry_size == 0) {
+            throw std::runtime_error("malformed hashtable file " + filename);
+        }
+
+        vector<u32> lengths(buckets);
+        file.read((char*) lengths.data(), lengths.size() * sizeof(u32));
+
+        // the entries of a bucket have to fit in its width, and the width
+        //  can't be more than the widest bucket needs, or a corrupt header
+        //  would have every bucket padded out to it
+        u64 widest = 0;
+        for (auto i = 0; i < buckets; i++) {
+            if (lengths[i] > width / entry_size) {
+                throw std::runtime_error("malformed hashtable file " + filename);
+            }
+            widest = std::max<u64>(widest, lengths[i]);
+        }
+        if (width > widest * entry_size) {
+            throw std::runtime_error("malformed hashtable file " + filename);
+        }
+
+        Hashtable hashtable(buckets, header[4] != 0);
+        hashtable.width = width;
+        hashtable.padded = true;
+        for (auto i = 0; i < buckets; i++) {
+            hashtable.table[i].resize(hashtable.width);
+            file.read((char*) hashtable.table[i].data(), lengths[i] * entry_size);
+            hashtable.occupancy[i] = lengths[i];
+            hashtable.size += lengths[i];
+        }
+        if (!file) { throw std::runtime_error("truncated hashtable file " + filename); }
+        return hashtable;
     }
 
     u64 Hashtable::buckets() {
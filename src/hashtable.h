@@ -1,6 +1,11 @@
 #pragma once
 
 #include "defines.h"
+#include "utils.h"
+
+// first u64 of a hashtable file that leaves out the padding ("PSISPARS"),
+//  where a padded file starts with its (much smaller) width instead
+#define HASHTABLE_SPARSE_MAGIC u64(0x5352415053495350)
 
 namespace unbalanced_psi {
     class Hashtable {
@@ -16,10 +21,19 @@ namespace unbalanced_psi {
         // number of entries inserted (does not include padding)
         u64 size;
 
+        // store entries without the bits implied by their bucket
+        bool compact;
+
+        // whether every bucket has been padded out to width
+        bool padded;
+
+        // number of entries in each bucket (the rest is padding)
+        vector<u64> occupancy;
+
         /**
          * setup hashtable with given number of buckets
          */
-        Hashtable(u64 buckets);
+        Hashtable(u64 buckets, bool compact = false);
 
         /**
          * hash encrypted input element to a bucket
@@ -28,9 +42,60 @@ namespace unbalanced_psi {
         static u64 hash(const u8* entry, u64 table_size);
 
         /**
-         * insert encrypted into a bucket given by it's own hash
+         * number of bytes a compacted entry takes: the bucket is the first
+         *  (up to) eight bytes mod table_size, so only their quotient by
+         *  table_size is kept, followed by the remaining bytes as they are
+         */
+        static u64 compact_size(u64 entry_size, u64 table_size);
+
+        /**
+         * number of bytes each entry takes in tables built with <params>
+         */
+        static u64 stored_size(const PSIParams& params);
+
+        /**
+         * drop the bits of <entry> implied by the bucket it hashes to
+         */
+        static vector<u8> compact_entry(const vector<u8>& entry, u64 table_size);
+
+        /**
+         * recover the full entry from its compacted form and bucket
+         *
+         * @params <compacted>  compact_size(entry_size, table_size) bytes
+         * @params <bucket>     bucket the entry was stored in
+         * @params <entry_size> number of bytes in the full entry
+         * @params <table_size> number of buckets in the table
+         */
+        static vector<u8> expand_entry(const u8* compacted, u64 bucket, u64 entry_size, u64 table_size);
+
+        /**
+         * insert encrypted into a bucket given by it's own hash (compacted
+         *  if the table is), taking the place of a slot of padding if the
+         *  table has been padded and the bucket has one to spare
+         *
+         * @return whether the table's width grew, which re-pads every
+         *         bucket of a padded table
+         */
+        bool insert(const vector<u8>& entry);
+
+        /**
+         * whether entry is one of the entries of its bucket
+         */
+        bool contains(const vector<u8>& entry);
+
+        /**
+         * take entry out of its bucket, padding the bucket back out to width
+         *  if the table has been padded (the width itself never shrinks)
+         *
+         * @return whether entry was in the table
+         */
+        bool remove(const vector<u8>& entry);
+
+        /**
+         * add all the entries of an (unpadded) hashtable with the same
+         *  number of buckets into this one
          */
-        void insert(const vector<u8>& entry);
+        void merge(const Hashtable& other);
 
         /**
          * pad all buckets with random elements to be bucket_size, or if
@@ -45,9 +110,24 @@ namespace unbalanced_psi {
         u64 buckets();
 
         /**
-         * write hashtable to file
+         * write hashtable to file, either every bucket padded out to width
+         *  or, given the size of an entry, only the entries of each bucket
+         *
+         * padded:  width, then each bucket's width bytes
+         * sparse:  HASHTABLE_SPARSE_MAGIC, width, number of buckets,
+         *          entry_size and whether entries are compact (all u64),
+         *          each bucket's number of entries (u32), then the entries
+         *          of each bucket in turn
+         *
+         * @params <entry_size> bytes each stored entry takes (0 for padded)
+         */
+        void to_file(string filename, u64 entry_size = 0);
+
+        /**
+         * read a (padded) hashtable from a sparse file written by to_file(),
+         *  which must be no wider than its widest bucket
          */
-        void to_file(string filename);
+        static Hashtable from_file(string filename);
 
         /**
          * write contents of hash table to log for debugging
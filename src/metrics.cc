@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "metrics.h"
+
+namespace unbalanced_psi {
+
+    Metrics& Metrics::global() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    u64 Metrics::thread_index() {
+        static std::atomic<u64> next(0);
+        thread_local u64 index = next++;
+        return index;
+    }
+
+    string Metrics::name(const string& message) {
+        string output;
+        bool separate = false;
+        for (char c : message) {
+            if (std::isalnum((unsigned char) c)) {
+                if (separate && !output.empty()) {
+                    // the bracketed role is split from the rest by a dot
+                    output += output.find('.') == string::npos ? '.' : '_';
+                }
+                output += std::tolower((unsigned char) c);
+                separate = false;
+            } else if (c == ']' || (c == ' ' && !output.empty())) {
+                separate = true;
+            }
+        }
+        return output;
+    }
+
+    void Metrics::count_hardware(bool enabled) {
+        if (enabled && !PerfCounters().available()) {
+            std::clog << "[ metric ] hardware counters unavailable (see perf_event_paranoid)" << std::endl;
+            return;
+        }
+        hardware = enabled;
+    }
+
+    bool Metrics::counting_hardware() {
+        return hardware;
+    }
+
+    void Metrics::time(const string& name, double seconds) {
+        u64 thread = thread_index();
+        std::lock_guard<std::mutex> guard(lock);
+        auto& stat = timers[name];
+        stat.seconds += seconds;
+        stat.calls++;
+        stat.threads[thread] += seconds;
+    }
+
+    void Metrics::count(const string& name, u64 amount) {
+        std::lock_guard<std::mutex> guard(lock);
+        counters[name] += amount;
+    }
+
+    void Metrics::bytes(const string& name, u64 amount) {
+        std::lock_guard<std::mutex> guard(lock);
+        gauges[name] = amount;
+    }
+
+    double Metrics::seconds(const string& name) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = timers.find(name);
+        return found == timers.end() ? 0 : found->second.seconds;
+    }
+
+    u64 Metrics::counter(const string& name) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = counters.find(name);
+        return found == counters.end() ? 0 : found->second;
+    }
+
+    u64 Metrics::gauge(const string& name) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = gauges.find(name);
+        return found == gauges.end() ? 0 : found->second;
+    }
+
+    void Metrics::reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        timers.clear();
+        counters.clear();
+        gauges.clear();
+    }
+
+    string Metrics::to_json() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(6);
+
+        json << "{\n  \"timers\": {";
+        for (auto it = timers.begin(); it != timers.end(); it++) {
+            json << (it == timers.begin() ? "\n" : ",\n");
+            json << "    \"" << it->first << "\": { \"seconds\": " << it->second.seconds;
+            json << ", \"calls\": " << it->second.calls << ", \"threads\": {";
+            for (auto th = it->second.threads.begin(); th != it->second.threads.end(); th++) {
+                json << (th == it->second.threads.begin() ? " " : ", ");
+                json << "\"" << th->first << "\": " << th->second;
+            }
+            json << " } }";
+        }
+        json << "\n  },\n  \"counters\": {";
+        for (auto it = counters.begin(); it != counters.end(); it++) {
+            json << (it == counters.begin() ? "\n" : ",\n");
+            json << "    \"" << it->first << "\": " << it->second;
+        }
+        json << "\n  },\n  \"bytes\": {";
+        for (auto it = gauges.begin(); it != gauges.end(); it++) {
+            json << (it == gauges.begin() ? "\n" : ",\n");
+            json << "    \"" << it->first << "\": " << it->second;
+        }
+        json << "\n  }\n}\n";
+        return json.str();
+    }
+
+    void Metrics::dump(const string& filename) {
+        std::ofstream file(filename, std::ios::out);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+        file << to_json();
+        file.close();
+    }
+
+    /**
+     * read a field like "VmHWM:    1234 kB" from /proc/self/status in bytes
+     */
+    static u64 proc_status(const string& field) {
+        std::ifstream status("/proc/self/status");
+        string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, field.size() + 1, field + ":") == 0) {
+                return std::stoull(line.substr(field.size() + 1)) * 1024;
+            }
+        }
+        return 0;
+    }
+
+    u64 current_rss() {
+        return proc_status("VmRSS");
+    }
+
+    u64 peak_rss() {
+        u64 peak = proc_status("VmHWM");
+        if (peak == 0) {
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            peak = u64(usage.ru_maxrss) * 1024;
+        }
+        return peak;
+    }
+
+    bool reset_peak_rss() {
+        // "5" resets the high water mark on linux 4.0+
+        std::ofstream clear("/proc/self/clear_refs");
+        if (!clear) { return false; }
+        clear << "5";
+        clear.close();
+        return bool(clear);
+    }
+
+    // memory phases currently running, since the peak is process-wide
+    static std::atomic<int> memory_phases(0);
+
+    MemoryPhase::MemoryPhase(string n) : name(n), running(true) {
+        // only the outermost phase may reset, or overlapping phases would
+        //  wipe each other's peaks
+        if (memory_phases.fetch_add(1) == 0) { reset_peak_rss(); }
+        start = current_rss();
+    }
+
+    MemoryPhase::~MemoryPhase() {
+        if (running) { stop(); }
+    }
+
+    void MemoryPhase::stop() {
+        // if the peak couldn't be reset it may predate this phase
+        u64 peak = std::max(peak_rss(), start);
+        Metrics::global().bytes(name + ".rss_start", start);
+        Metrics::global().bytes(name + ".peak_rss", peak);
+        Metrics::global().bytes(name + ".peak_delta", peak - start);
+        memory_phases--;
+        running = false;
+    }
+
+    Phase::Phase(string n) : name(n), running(true) {
+        if (Metrics::global().counting_hardware()) {
+            counters = std::make_unique<PerfCounters>();
+        }
+        start = std::chrono::high_resolution_clock::now();
+    }
+
+    Phase::~Phase() {
+        if (running) { stop(); }
+    }
+
+    void Phase::stop() {
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+        Metrics::global().time(name, elapsed.count());
+        if (counters) { counters->report(name); }
+        running = false;
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "defines.h"
+#include "perf.h"
+
+namespace unbalanced_psi {
+
+    /**
+     * registry of named timers, counters and byte gauges for a single run
+     *
+     * timer names follow <role>.<phase>.<compute|network|disk> so that each
+     *  phase's time can be split by what it was spent on
+     */
+    class Metrics {
+
+        struct TimerStat {
+            double seconds = 0;
+            u64 calls = 0;
+
+            // seconds spent by each thread that reported this timer
+            std::map<u64, double> threads;
+        };
+
+        std::mutex lock;
+        std::map<string, TimerStat> timers;
+        std::map<string, u64> counters;
+        std::map<string, u64> gauges;
+
+        // whether phases also read hardware counters
+        std::atomic<bool> hardware{false};
+
+        public:
+
+        /**
+         * registry shared by the whole process
+         */
+        static Metrics& global();
+
+        /**
+         * small stable index of the calling thread (in order of first report)
+         */
+        static u64 thread_index();
+
+        /**
+         * convert a Timer message like "[ server ] oprf online" into a
+         *  metric name like "server.oprf_online"
+         */
+        static string name(const string& message);
+
+        /**
+         * have phases started from now on also count hardware events into
+         *  <name>.cycles, <name>.instructions, ... where the kernel allows it
+         */
+        void count_hardware(bool enabled);
+        bool counting_hardware();
+
+        /**
+         * add elapsed seconds to a timer
+         */
+        void time(const string& name, double seconds);
+
+        /**
+         * add to a counter
+         */
+        void count(const string& name, u64 amount = 1);
+
+        /**
+         * set a byte gauge, overwriting any previous value
+         */
+        void bytes(const string& name, u64 amount);
+
+        /**
+         * read back a recorded value (zero if never reported)
+         */
+        double seconds(const string& name);
+        u64 counter(const string& name);
+        u64 gauge(const string& name);
+
+        /**
+         * forget everything recorded so far
+         */
+        void reset();
+
+        /**
+         * everything recorded so far as a json object
+         */
+        string to_json();
+
+        /**
+         * write to_json() to a file
+         */
+        void dump(const string& filename);
+    };
+
+    /**
+     * resident memory of this process in bytes, read from /proc/self/status
+     *  (falling back to getrusage, which only knows the peak)
+     */
+    u64 current_rss();
+    u64 peak_rss();
+
+    /**
+     * restart peak_rss() from the current resident memory where the kernel
+     *  allows it, returning whether it did
+     */
+    bool reset_peak_rss();
+
+    /**
+     * records the resident memory at the start of a phase and the peak reached
+     *  during it as <name>.rss_start, <name>.peak_rss and <name>.peak_delta
+     *
+     * the peak is process-wide, so it is only reset when no other phase is
+     *  running, and a phase overlapping others reports the peak since the
+     *  first of them started
+     */
+    class MemoryPhase {
+        public:
+            MemoryPhase(string name);
+            ~MemoryPhase();
+            void stop();
+        private:
+            string name;
+            bool running;
+            u64 start;
+    };
+
+    /**
+     * times a phase into the global registry without printing anything,
+     *  stopping when it goes out of scope if not stopped before
+     */
+    class Phase {
+        public:
+            Phase(string name);
+            ~Phase();
+            void stop();
+        private:
+            string name;
+            bool running;
+            std::chrono::time_point<std::chrono::high_resolution_clock> start;
+            std::unique_ptr<PerfCounters> counters;
+    };
+}
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <sstream>
+
+#include <cryptoTools/Common/CLP.h>
+
+#include "cuckoo.h"
+#include "hashtable.h"
+#include "utils.h"
+
+#define MICROBENCH_SCRATCH "out/microbench.table"
+
+// average # of entries per hashtable bucket when benchmarking hashtables
+#define MICROBENCH_BUCKET_LOAD 16
+
+using namespace unbalanced_psi;
+
+/**
+ * a single primitive to measure
+ */
+struct Benchmark {
+    string name;
+
+    // whether the work can be split across threads
+    bool threaded;
+
+    // untimed setup before each repetition
+    std::function<void(u64 size)> prepare;
+
+    // timed work over elements [begin, end)
+    std::function<void(u64 begin, u64 end)> run;
+};
+
+/**
+ * timings of one benchmark at one size and thread count
+ */
+struct Result {
+    string name;
+    u64 size;
+    int threads;
+
+    // nanoseconds per element for each repetition, sorted
+    vector<double> nanoseconds;
+
+    double percentile(double p) const {
+        u64 rank = std::min<u64>(nanoseconds.size() - 1, p * nanoseconds.size());
+        return nanoseconds[rank];
+    }
+
+    double mean() const {
+        double total = 0;
+        for (auto ns : nanoseconds) { total += ns; }
+        return total / nanoseconds.size();
+    }
+};
+
+/**
+ * time a single pass of a benchmark, splitting the elements across threads
+ */
+double run_once(const Benchmark& benchmark, u64 size, int threads) {
+    auto start = high_resolution_clock::now();
+    if (threads == 1) {
+        benchmark.run(0, size);
+    } else {
+        u64 batch = size / threads + (size % threads != 0);
+        vector<future<void>> futures(threads);
+        for (auto i = 0; i < threads; i++) {
+            u64 begin = std::min<u64>(i * batch, size);
+            u64 end = std::min<u64>(begin + batch, size);
+            futures[i] = std::async(std::launch::async, benchmark.run, begin, end);
+        }
+        for (auto& f : futures) { f.get(); }
+    }
+    duration<double> elapsed = high_resolution_clock::now() - start;
+    return elapsed.count();
+}
+
+Result measure(const Benchmark& benchmark, u64 size, int threads, int warmup, int reps) {
+    Result result { benchmark.name, size, threads, {} };
+    for (auto i = 0; i < warmup + reps; i++) {
+        benchmark.prepare(size);
+        double seconds = run_once(benchmark, size, threads);
+        if (i >= warmup) { result.nanoseconds.push_back(seconds * 1e9 / size); }
+    }
+    std::sort(result.nanoseconds.begin(), result.nanoseconds.end());
+    return result;
+}
+
+string to_json(const vector<Result>& results, const string& label, int warmup, int reps) {
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n  \"label\": \"" << label << "\",\n";
+    json << "  \"warmup\": " << warmup << ",\n  \"reps\": " << reps << ",\n";
+    json << "  \"results\": [";
+    for (auto i = 0; i < results.size(); i++) {
+        auto& result = results[i];
+        json << (i == 0 ? "\n" : ",\n");
+        json << "    { \"name\": \"" << result.name << "\", \"size\": " << result.size;
+        json << ", \"threads\": " << result.threads << ", \"ns_per_op\": {";
+        json << " \"min\": " << result.nanoseconds.front();
+        json << ", \"p50\": " << result.percentile(0.5);
+        json << ", \"p90\": " << result.percentile(0.9);
+        json << ", \"p99\": " << result.percentile(0.99);
+        json << ", \"max\": " << result.nanoseconds.back();
+        json << ", \"mean\": " << result.mean() << " } }";
+    }
+    json << "\n  ]\n}\n";
+    return json.str();
+}
+
+int main(int argc, char *argv[]) {
+    osuCrypto::CLP parser;
+	parser.parse(argc, argv);
+
+    auto sizes = parser.getManyOr<u64>("-sizes", { 1 << 10, 1 << 14 });
+    auto thread_counts = parser.getManyOr<int>("-threads", { 1 });
+    int warmup = parser.getOr<int>("-warmup", 2);
+    int reps = parser.getOr<int>("-reps", 10);
+    string filter = parser.getOr<string>("-filter", "");
+    string scratch = parser.getOr<string>("-scratch", MICROBENCH_SCRATCH);
+
+    // inputs are generated once for the largest size and shared by every run
+    u64 largest = *std::max_element(sizes.begin(), sizes.end());
+    auto dataset = generate_dataset(largest);
+
+    Number key;
+    Point::MakeRandomNonzeroScalar(key);
+
+    vector<Point> points(largest);
+    vector<u8> saved(largest * Point::save_size);
+    vector<hash_type> hashes(largest, hash_type(HASH_3_SIZE));
+    for (auto i = 0; i < largest; i++) {
+        points[i] = hash_to_group_element(dataset[i]);
+        points[i].save(Point::point_save_span_type{saved.data() + i * Point::save_size, Point::save_size});
+        hash_group_element(points[i], HASH_3_SIZE, hashes[i].data());
+    }
+
+    // state rebuilt before each repetition of the stateful benchmarks
+    std::unique_ptr<Hashtable> hashtable;
+    std::unique_ptr<CuckooVector> cuckoo;
+    auto nothing = [](u64) { };
+    auto fill = [&](u64 size) {
+        hashtable = std::make_unique<Hashtable>(std::max<u64>(1, size / MICROBENCH_BUCKET_LOAD));
+        for (auto i = 0; i < size; i++) { hashtable->insert(hashes[i]); }
+    };
+
+    vector<Benchmark> benchmarks = {
+        { "hash_to_group_element", true, nothing, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) { hash_to_group_element(dataset[i]); }
+        }},
+        { "scalar_multiply_server", true, nothing, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) {
+                Point point = points[i];
+                point.scalar_multiply(key, true);
+            }
+        }},
+        { "scalar_multiply_client", true, nothing, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) {
+                Point point = points[i];
+                point.scalar_multiply(key, false);
+            }
+        }},
+        { "hash_group_element", true, nothing, [&](u64 begin, u64 end) {
+            u8 output[HASH_3_SIZE];
+            for (auto i = begin; i < end; i++) { hash_group_element(points[i], HASH_3_SIZE, output); }
+        }},
+        { "hash_to_group_elements", true, nothing, [&](u64 begin, u64 end) {
+            vector<Point> output(HASH_BATCH_SIZE);
+            for (auto i = begin; i < end; i += HASH_BATCH_SIZE) {
+                hash_to_group_elements(dataset.data() + i, std::min<u64>(HASH_BATCH_SIZE, end - i), output.data());
+            }
+        }},
+        { "hash_group_elements", true, nothing, [&](u64 begin, u64 end) {
+            hash_type output((end - begin) * HASH_3_SIZE);
+            hash_group_elements(points.data() + begin, end - begin, HASH_3_SIZE, output.data());
+        }},
+        { "point_load", true, nothing, [&](u64 begin, u64 end) {
+            Point point;
+            for (auto i = begin; i < end; i++) {
+                point.load(Point::point_save_span_const_type{
+                    saved.data() + i * Point::save_size, Point::save_size
+                });
+            }
+        }},
+        { "point_save", true, nothing, [&](u64 begin, u64 end) {
+            vector<u8> output(Point::save_size);
+            for (auto i = begin; i < end; i++) {
+                points[i].save(Point::point_save_span_type{output.data(), Point::save_size});
+            }
+        }},
+        { "cuckoo_hash", true, nothing, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) { cuckoo_hash(hashes[i], i % 3, largest); }
+        }},
+        { "hashtable_insert", false, [&](u64 size) {
+            hashtable = std::make_unique<Hashtable>(std::max<u64>(1, size / MICROBENCH_BUCKET_LOAD));
+        }, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) { hashtable->insert(hashes[i]); }
+        }},
+        { "hashtable_pad", false, fill, [&](u64, u64) {
+            hashtable->pad();
+        }},
+        { "hashtable_to_file", false, [&](u64 size) {
+            fill(size);
+            hashtable->pad();
+        }, [&](u64, u64) {
+            hashtable->to_file(scratch);
+        }},
+        { "hashtable_to_file_sparse", false, [&](u64 size) {
+            fill(size);
+            hashtable->pad();
+        }, [&](u64, u64) {
+            hashtable->to_file(scratch, HASH_3_SIZE);
+        }},
+        { "cuckoo_vector_insert", false, [&](u64 size) {
+            // ~1.5x as many buckets as entries, so insertion reliably succeeds
+            cuckoo = std::make_unique<CuckooVector>(PSIParams(size + size / 2 + 1, 3, 1, 1));
+        }, [&](u64 begin, u64 end) {
+            for (auto i = begin; i < end; i++) { cuckoo->insert(hashes[i], i); }
+        }},
+    };
+
+    vector<Result> results;
+    for (auto& benchmark : benchmarks) {
+        if (benchmark.name.find(filter) == string::npos) { continue; }
+        for (auto size : sizes) {
+            for (auto threads : thread_counts) {
+                if (!benchmark.threaded && threads != 1) { continue; }
+                auto result = measure(benchmark, size, threads, warmup, reps);
+                std::cout << std::fixed << std::setprecision(1);
+                std::cout << "[  bench ] " << result.name << " n=" << size << " t=" << threads;
+                std::cout << " (ns/op)\t: p50=" << result.percentile(0.5);
+                std::cout << " p90=" << result.percentile(0.9);
+                std::cout << " p99=" << result.percentile(0.99) << std::endl;
+                results.push_back(result);
+            }
+        }
+    }
+    std::remove(scratch.c_str());
+
+    if (parser.isSet("-json")) {
+        std::ofstream file(parser.get<string>("-json"), std::ios::out);
+        if (!file) { throw std::runtime_error("cannot open " + parser.get<string>("-json")); }
+        file << to_json(results, parser.getOr<string>("-label", ""), warmup, reps);
+    }
+    return 0;
+}
@@ -1,93 +1,530 @@
+#include <memory>
+#include <sstream>
+
+#include <boost/asio.hpp>
+#include <coproto/Socket/AsioSocket.h>
 #include <cryptoTools/Common/CLP.h>
 
 #include "client.h"
+#include "coordinator.h"
 #include "server.h"
+#include "shaper.h"
 
 using namespace unbalanced_psi;
 
+/**
+ * open a number of channels over the same session and wait for them to connect
+ */
+vector<Channel> open_channels(Session& session, int count) {
+    vector<Channel> channels;
+    for (auto i = 0; i < count; i++) {
+        channels.push_back(session.addChannel());
+    }
+    for (auto& channel : channels) {
+        channel.waitForConnection();
+    }
+    return channels;
+}
+
+/**
+ * name of the session for the client with the given id
+ */
+std::string session_name(u64 client_id) {
+    return client_id == 0 ? "pirpsi" : "pirpsi-" + std::to_string(client_id);
+}
+
+/**
+ * print the peak resident memory of a phase recorded with a MemoryPhase
+ */
+void report_memory(const std::string& message, const std::string& phase, const std::string& color) {
+    u64 peak = Metrics::global().gauge(phase + ".peak_rss");
+    if (peak == 0) { return; }
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3);
+    line << color << message << " (MB)\t: " << peak / 1000000.0 << RESET << "\n";
+    std::cout << line.str() << std::flush;
+}
+
+/**
+ * route the client's connections through a local proxy emulating a slower
+ *  link if any of --bandwidth (Mbps), --rtt (ms) or --jitter (ms) are given
+ */
+std::unique_ptr<Shaper> shape_link(osuCrypto::CLP& parser) {
+    if (!parser.isSet("-bandwidth") && !parser.isSet("-rtt") && !parser.isSet("-jitter")) {
+        return nullptr;
+    }
+    LinkParams link(
+        parser.getOr<double>("-bandwidth", 0),
+        parser.getOr<double>("-rtt", 0),
+        parser.getOr<double>("-jitter", 0)
+    );
+    std::clog << "[ client ] emulating " << link.bandwidth << " Mbps, " << link.rtt
+              << " ms rtt, " << link.jitter << " ms jitter" << std::endl;
+    return std::make_unique<Shaper>(SHAPER_ADDRESS, "127.0.0.1:1212", link);
+}
+
+/**
+ * record what crossed the emulated link, if the client went through one
+ */
+void report_link(const std::unique_ptr<Shaper>& shaper) {
+    if (!shaper) { return; }
+    Metrics::global().bytes("client.link.sent", shaper->bytes_sent());
+    Metrics::global().bytes("client.link.received", shaper->bytes_received());
+    Metrics::global().bytes("client.link.in_flight_limit", shaper->in_flight_limit());
+    Metrics::global().time("client.link.delayed", shaper->delayed());
+}
+
+/**
+ * client side of the online oprf over a coproto socket instead of channels
+ */
+void async_client(Client& client, u64 client_id, const std::string& address) {
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    std::thread io([&]() { ioc.run(); });
+
+    auto socket = coproto::asioConnect(address, false, ioc);
+
+    Timer offline("[ client ] oprf offline", YELLOW);
+    client.offline();
+    offline.stop();
+    report_memory("[ client ] oprf offline peak rss", "client.offline.memory", YELLOW);
+
+    // wait for signal that server is ready for online
+    u8 ready;
+    coproto::sync_wait(socket.recv(ready));
+    u64 sent = socket.bytesSent(), received = socket.bytesReceived();
+
+    Timer online("[ client ] oprf online", YELLOW);
+    auto [ results, queries ] = coproto::sync_wait(client.online(socket));
+    online.stop();
+    report_memory("[ client ] oprf online peak rss", "client.online.memory", YELLOW);
+
+    Metrics::global().bytes("client.network.sent", socket.bytesSent() - sent);
+    Metrics::global().bytes("client.network.received", socket.bytesReceived() - received);
+
+    float comm = (socket.bytesSent() - sent) + (socket.bytesReceived() - received);
+    std::cout << "[  both  ] oprf comm (MB)\t: " << comm / 1000000 << std::endl;
+
+    coproto::sync_wait(socket.flush());
+    socket.close();
+    work.reset();
+    io.join();
+
+    std::string suffix = client_id == 0 ? "" : "." + std::to_string(client_id);
+    write_results(results, CLIENT_ONLINE_OUTPUT + suffix);
+    write_dataset(queries, CLIENT_QUERY_OUTPUT + suffix);
+    client.resolver().to_file(RESOLVER_INDEX_OUTPUT + suffix);
+}
+
+/**
+ * write the server's hashtables to files for pir, leaving the padding for
+ *  the pir server to fill back in
+ *
+ * @params <indexes> which of the cuckoo table's hashtables these are (all
+ *                   of them, in order, if empty)
+ */
+void write_hashtables(vector<Hashtable>& hashtables, PSIParams& params, vector<u64> indexes = {}) {
+    u64 entry_size = Hashtable::stored_size(params);
+    if (params.cuckoo_size == 1) {
+        hashtables[0].to_file(SERVER_OFFLINE_OUTPUT, entry_size);
+        return;
+    }
+
+    for (auto i = 0; i < hashtables.size(); i++) {
+        hashtables[i].to_file(
+            SERVER_OFFLINE_OUTPUT_PREFIX
+            + std::to_string(indexes.empty() ? i : indexes[i])
+            + SERVER_OFFLINE_OUTPUT_SUFFIX,
+            entry_size
+        );
+    }
+}
+
+/**
+ * server side of the online oprf, multiplexing every client's session onto
+ *  a single networking thread and handing the encryption to a small pool
+ */
+void async_server(Server& server, u64 client_n, PSIParams& params, osuCrypto::CLP& parser) {
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    std::thread io([&]() { ioc.run(); });
+
+    vector<coproto::AsioSocket> sockets;
+    for (auto i = 0; i < client_n; i++) {
+        sockets.push_back(coproto::asioConnect("127.0.0.1:1212", true, ioc));
+    }
+
+    // online only needs the key, so build and write the hashtables meanwhile
+    server.keygen();
+    auto binning = std::async(std::launch::async, [&]() {
+        Timer offline("[ server ] oprf offline", BLUE);
+        auto hashtables = server.bin();
+        offline.stop();
+        report_memory("[ server ] oprf offline peak rss", "server.offline.memory", BLUE);
+        write_hashtables(hashtables, params);
+    });
+
+    // batched sessions wait on the batcher without holding a thread, so a
+    //  single pool thread serves any number of clients
+    macoro::thread_pool pool;
+    auto pool_work = pool.make_work();
+    pool.create_thread();
+    if (client_n > 1) {
+        server.batch(
+            parser.getOr<u64>("-batch-points", BATCH_MAX_POINTS),
+            parser.getOr<u64>("-batch-delay", BATCH_MAX_DELAY)
+        );
+    }
+
+    for (auto& socket : sockets) {
+        coproto::sync_wait(socket.send(u8(1)));
+    }
+
+    Timer online("[ server ] oprf online", BLUE);
+    vector<coproto::task<void>> sessions;
+    for (auto& socket : sockets) {
+        sessions.push_back(server.online(socket, pool));
+    }
+    auto done = coproto::sync_wait(macoro::when_all_ready(std::move(sessions)));
+    for (auto& session : done) { session.result(); }
+    online.stop();
+    report_memory("[ server ] oprf online peak rss", "server.online.memory", BLUE);
+
+    u64 sent = 0, received = 0;
+    for (auto& socket : sockets) {
+        sent += socket.bytesSent();
+        received += socket.bytesReceived();
+    }
+    Metrics::global().bytes("server.network.sent", sent);
+    Metrics::global().bytes("server.network.received", received);
+
+    for (auto& socket : sockets) {
+        coproto::sync_wait(socket.flush());
+        socket.close();
+    }
+    pool_work.reset();
+    pool.join();
+    work.reset();
+    io.join();
+
+    binning.get();
+}
+
+/**
+ * dump everything recorded this run as json if asked to with --metrics
+ */
+void write_metrics(osuCrypto::CLP& parser) {
+    if (parser.isSet("-metrics")) {
+        Metrics::global().dump(parser.get<std::string>("-metrics"));
+    }
+}
+
 int main(int argc, char *argv[]) {
     osuCrypto::CLP parser;
 	parser.parse(argc, argv);
 
+    // print the false positive bound of each entry size and exit
+    if (parser.isSet("-false-positives")) {
+        u64 server_size = parser.get<u64>("-server-size");
+        u64 client_size = parser.get<u64>("-client-size");
+        for (u64 entry_size : { 6, 8, 10, 16 }) {
+            std::cout << "[ fp     ] " << entry_size << " byte entries\t: ";
+            std::cout << std::scientific << false_positive_bound(server_size, client_size, entry_size);
+            std::cout << std::endl;
+        }
+        double rate = parser.getOr<double>("-false-positives", FALSE_POSITIVE_RATE);
+        std::cout << "[ fp     ] smallest under " << rate << "\t: ";
+        std::cout << smallest_entry_size(server_size, client_size, rate) << " bytes" << std::endl;
+        return 0;
+    }
+
     auto params = PSIParams(
         parser.get<u64>("-cuckoo-size"),
         parser.get<u64>("-cuckoo-hashes"),
         parser.get<u64>("-hashtable-size"),
         parser.getOr<int>("-threads", 1)
     );
+    params.entry_size = parser.getOr<u64>("-entry-size", HASH_3_SIZE);
+    if (!supported_entry_size(params.entry_size)) {
+        throw std::runtime_error("entry size must be 6, 8, 10 or 16 bytes");
+    }
+    params.compact = !parser.isSet("-no-compact");
 
-    IOService ios(params.threads);
+    // count cycles, instructions and cache/branch misses in every phase
+    if (parser.isSet("-perf")) { Metrics::global().count_hardware(true); }
+
+    // number of channels to split the online oprf across
+    int channel_n = parser.getOr<int>("-channels", 1);
+
+    IOService ios(std::max(params.threads, channel_n));
     ios.mPrint = false;
 
     if (parser.isSet("client") || parser.isSet("-client")) {
         Client client(CLIENT_INPUT, params);
 
+        // which of the server's concurrent clients this is
+        u64 client_id = parser.getOr<u64>("-client-id", 0);
+        std::string suffix = client_id == 0 ? "" : "." + std::to_string(client_id);
+
+        // only query the items without an output from an earlier run
+        std::unique_ptr<ResultCache> results_cache;
+        if (parser.isSet("-result-cache")) {
+            results_cache = std::make_unique<ResultCache>(
+                parser.getOr<std::string>("-result-cache", CLIENT_RESULT_CACHE + suffix), params.entry_size
+            );
+            client.reuse(*results_cache);
+        }
+
+        // times measured through the proxy are those of the emulated link
+        auto shaper = shape_link(parser);
+        std::string address = shaper ? SHAPER_ADDRESS : "127.0.0.1:1212";
+
+        if (parser.isSet("-async")) {
+            async_client(client, client_id, address);
+            if (results_cache) { results_cache->to_file(); }
+            report_link(shaper);
+            write_metrics(parser);
+            return 0;
+        }
+
         // set up network connections
-        Session session(ios, "127.0.0.1:1212", SessionMode::Client, "pirpsi");
-        Channel channel = session.addChannel();
-        channel.waitForConnection();
+        Session session(ios, address, SessionMode::Client, session_name(client_id));
+        auto channels = open_channels(session, channel_n);
 
         Timer offline("[ client ] oprf offline", YELLOW);
         client.offline();
         offline.stop();
+        report_memory("[ client ] oprf offline peak rss", "client.offline.memory", YELLOW);
 
         // wait for signal that server is ready for online
         vector<u8> ready(1);
-        channel.recv(ready.data(), 1);
-        channel.resetStats();
+        channels[0].recv(ready.data(), 1);
+        for (auto& channel : channels) { channel.resetStats(); }
 
         Timer online("[ client ] oprf online", YELLOW);
-        auto [ results, queries ] = client.online(channel);
+        auto [ results, queries ] = client.online(channels);
         online.stop();
+        report_memory("[ client ] oprf online peak rss", "client.online.memory", YELLOW);
+
+        u64 sent = 0, received = 0;
+        for (auto& channel : channels) {
+            sent += channel.getTotalDataSent();
+            received += channel.getTotalDataRecv();
+        }
+        Metrics::global().bytes("client.network.sent", sent);
+        Metrics::global().bytes("client.network.received", received);
 
-        float comm = channel.getTotalDataSent() + channel.getTotalDataRecv();
+        float comm = sent + received;
         std::cout << "[  both  ] oprf comm (MB)\t: " << comm / 1000000 << std::endl;
 
-        channel.close();
+        for (auto& channel : channels) { channel.close(); }
         session.stop();
+        report_link(shaper);
 
-        // write results to files
-        write_results(results, CLIENT_ONLINE_OUTPUT);
-        write_dataset(queries, CLIENT_QUERY_OUTPUT);
+        // write results to files (keeping concurrent clients apart)
+        write_results(results, CLIENT_ONLINE_OUTPUT + suffix);
+        write_dataset(queries, CLIENT_QUERY_OUTPUT + suffix);
+        client.resolver().to_file(RESOLVER_INDEX_OUTPUT + suffix);
+        if (results_cache) { results_cache->to_file(); }
 
-    } else if (parser.isSet("server") || parser.isSet("-server")) {
-        Server server(SERVER_OFFLINE_INPUT, params);
+    } else if ((parser.isSet("server") || parser.isSet("-server")) && parser.isSet("-shard")) {
+        // one of several servers which each hold some of the hashtables
+        u64 shard = parser.get<u64>("-shard");
+        u64 shard_n = parser.get<u64>("-shards");
+        if (shard >= shard_n || shard_n > params.cuckoo_size) {
+            std::cerr << "need --shard < --shards <= --cuckoo-size, as each shard holds whole hashtables" << std::endl;
+            return 1;
+        }
+        auto dataset = Coordinator::slice(read_dataset<INPUT_TYPE>(SERVER_OFFLINE_INPUT), shard, shard_n);
 
-        // set up network connections
-        Session session(ios, "127.0.0.1:1212", SessionMode::Server, "pirpsi");
+        // set up network connection with the coordinator
+        Session session(
+            ios, COORDINATOR_ADDRESS, SessionMode::Client,
+            COORDINATOR_SESSION_PREFIX + std::to_string(shard)
+        );
         Channel channel = session.addChannel();
         channel.waitForConnection();
 
-        Timer offline("[ server ] oprf offline", BLUE);
-        auto hashtables = server.offline();
-        offline.stop();
-
-        vector<u8> ready { 1 };
-        channel.send(ready);
-        channel.resetStats();
+        Shard worker(dataset, params, shard, shard_n, channel);
+        auto hashtables = worker.offline();
 
-        Timer online("[ server ] oprf online", BLUE);
-        server.online(channel);
-        online.stop();
+        // the coordinator (and client) can go online while the tables are written
+        auto writing = std::async(std::launch::async, [&]() {
+            write_hashtables(hashtables, params, Shard::tables(shard, shard_n, params));
+        });
+        worker.online();
+        writing.get();
 
         channel.close();
         session.stop();
 
-        if (params.cuckoo_size == 1) {
-            hashtables[0].to_file(SERVER_OFFLINE_OUTPUT);
+    } else if (parser.isSet("server") || parser.isSet("-server")) {
+        u64 shard_n = parser.getOr<u64>("-shards", 0);
+        if (shard_n > params.cuckoo_size) {
+            std::cerr << "--shards can't be more than --cuckoo-size, as each shard holds whole hashtables" << std::endl;
+            return 1;
+        }
+        if (shard_n > 0 && parser.getOr<u64>("-clients", 1) > 1) {
+            std::cerr << "--clients can't be combined with --shards" << std::endl;
+            return 1;
+        }
+        if (parser.isSet("-async") && (shard_n > 0 || parser.isSet("-cache"))) {
+            std::cerr << "--async can't be combined with --shards or --cache" << std::endl;
+            return 1;
+        }
+        if ((parser.isSet("-epochs") || parser.isSet("-rotate")) && !parser.isSet("-cache")) {
+            std::cerr << "--epochs and --rotate need --cache to keep the key in" << std::endl;
+            return 1;
+        }
+        if (parser.isSet("-epochs") && shard_n > 0) {
+            std::cerr << "--epochs can't be combined with --shards" << std::endl;
+            return 1;
+        }
+        bool updating = parser.isSet("-added") || parser.isSet("-removed");
+        if (updating && (shard_n > 0 || parser.isSet("-async"))) {
+            std::cerr << "--added and --removed can't be combined with --shards or --async" << std::endl;
+            return 1;
+        }
+
+        // either hold the whole dataset or coordinate the servers which do
+        std::unique_ptr<Server> server;
+        std::unique_ptr<Coordinator> coordinator;
+        vector<Session> shard_sessions;
+        if (shard_n == 0) {
+            server = std::make_unique<Server>(SERVER_OFFLINE_INPUT, params);
+        } else {
+            vector<Channel> shard_channels;
+            for (auto i = 0; i < shard_n; i++) {
+                shard_sessions.emplace_back(
+                    ios, COORDINATOR_ADDRESS, SessionMode::Server,
+                    COORDINATOR_SESSION_PREFIX + std::to_string(i)
+                );
+                shard_channels.push_back(shard_sessions.back().addChannel());
+            }
+            for (auto& channel : shard_channels) { channel.waitForConnection(); }
+            coordinator = std::make_unique<Coordinator>(shard_channels, params);
+        }
+
+        // set up network connections, with a session for each concurrent client
+        u64 client_n = parser.getOr<u64>("-clients", 1);
+        if (parser.isSet("-async")) {
+            async_server(*server, client_n, params, parser);
+            write_metrics(parser);
             return 0;
         }
 
-        for (auto i = 0; i < hashtables.size(); i++) {
-            hashtables[i].to_file(
-                SERVER_OFFLINE_OUTPUT_PREFIX
-                + std::to_string(i)
-                + SERVER_OFFLINE_OUTPUT_SUFFIX
+        vector<Session> sessions;
+        vector<vector<Channel>> clients;
+        for (auto i = 0; i < client_n; i++) {
+            sessions.emplace_back(ios, "127.0.0.1:1212", SessionMode::Server, session_name(i));
+            clients.push_back(open_channels(sessions.back(), channel_n));
+        }
+
+        std::unique_ptr<OfflineCache> cache;
+        if (parser.isSet("-cache")) {
+            cache = std::make_unique<OfflineCache>(
+                parser.get<std::string>("-cache"),
+                parser.getOr<std::string>("-cache-key", "")
+            );
+        }
+
+        vector<Hashtable> hashtables;
+        future<void> binning;
+        if (coordinator) {
+            // the shards write their own hashtables
+            Timer offline("[ server ] oprf offline", BLUE);
+            coordinator->offline();
+            offline.stop();
+            report_memory("[ server ] oprf offline peak rss", "server.offline.memory", BLUE);
+        } else {
+            // keep the key between runs so clients can reuse their outputs
+            if (parser.isSet("-epochs") || parser.isSet("-rotate")) {
+                u64 epoch = server->use_epoch(*cache, parser.isSet("-rotate"));
+                std::clog << "[ server ] using key epoch " << epoch << std::endl;
+            }
+
+            // online only needs the key, so the clients are answered while
+            //  the hashtables are built, updated and written on other threads
+            server->keygen(cache.get());
+            binning = std::async(std::launch::async, [&]() {
+                Timer offline("[ server ] oprf offline", BLUE);
+                hashtables = server->bin();
+                offline.stop();
+                report_memory("[ server ] oprf offline peak rss", "server.offline.memory", BLUE);
+
+                // apply a delta to the dataset, changing only the buckets it touches
+                if (updating) {
+                    vector<INPUT_TYPE> added, removed;
+                    if (parser.isSet("-added")) { added = read_dataset<INPUT_TYPE>(parser.get<std::string>("-added")); }
+                    if (parser.isSet("-removed")) { removed = read_dataset<INPUT_TYPE>(parser.get<std::string>("-removed")); }
+
+                    Timer update("[ server ] oprf update", BLUE);
+                    auto delta = cache ?
+                        server->update(hashtables, added, removed, *cache) :
+                        server->update(hashtables, added, removed);
+                    update.stop();
+
+                    // the updated dataset is what the next run (and its cache) starts from
+                    server->to_file(SERVER_OFFLINE_INPUT);
+                    delta.to_file(SERVER_UPDATE_OUTPUT);
+                }
+                write_hashtables(hashtables, params);
+            });
+        }
+
+        // share evaluation batches between the clients
+        if (server && client_n > 1) {
+            server->batch(
+                parser.getOr<u64>("-batch-points", BATCH_MAX_POINTS),
+                parser.getOr<u64>("-batch-delay", BATCH_MAX_DELAY)
             );
         }
+
+        Timer online("[ server ] oprf online", BLUE);
+        vector<future<void>> futures(client_n);
+        for (auto i = 0; i < client_n; i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                auto& channels = clients[i];
+
+                vector<u8> ready { 1 };
+                channels[0].send(ready);
+                for (auto& channel : channels) { channel.resetStats(); }
+
+                if (coordinator) {
+                    coordinator->online(channels);
+                } else {
+                    server->online(channels);
+                }
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+        online.stop();
+        report_memory("[ server ] oprf online peak rss", "server.online.memory", BLUE);
+
+        u64 sent = 0, received = 0;
+        for (auto& channels : clients) {
+            for (auto& channel : channels) {
+                sent += channel.getTotalDataSent();
+                received += channel.getTotalDataRecv();
+            }
+        }
+        Metrics::global().bytes("server.network.sent", sent);
+        Metrics::global().bytes("server.network.received", received);
+
+        for (auto& channels : clients) {
+            for (auto& channel : channels) { channel.close(); }
+        }
+        for (auto& session : sessions) { session.stop(); }
+        for (auto& shard_session : shard_sessions) { shard_session.stop(); }
+
+        // rethrows anything that went wrong building the hashtables
+        if (binning.valid()) {
+            binning.get();
+        }
     } else {
         std::cerr << "need to specify either --server or --client" << std::endl;
         return 1;
     }
+    write_metrics(parser);
     return 0;
 }
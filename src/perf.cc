@@ -0,0 +1,87 @@
+#include "perf.h"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace unbalanced_psi {
+
+    const array<string, PERF_EVENTS> PerfCounters::names = {
+        "cycles", "instructions", "llc_misses", "branch_misses"
+    };
+
+    static const array<u64, PERF_EVENTS> CONFIGS = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    PerfCounters::PerfCounters() {
+        for (auto i = 0; i < PERF_EVENTS; i++) {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = CONFIGS[i];
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            // also count worker threads started during the phase (which rules
+            //  out reading the events as one group)
+            attributes.inherit = 1;
+            attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            descriptors[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+        }
+        for (auto descriptor : descriptors) {
+            if (descriptor >= 0) {
+                ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+                ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    PerfCounters::~PerfCounters() {
+        for (auto descriptor : descriptors) {
+            if (descriptor >= 0) { close(descriptor); }
+        }
+    }
+
+    bool PerfCounters::available() {
+        for (auto descriptor : descriptors) {
+            if (descriptor >= 0) { return true; }
+        }
+        return false;
+    }
+
+    array<u64, PERF_EVENTS> PerfCounters::read() {
+        array<u64, PERF_EVENTS> counts{};
+        for (auto i = 0; i < PERF_EVENTS; i++) {
+            if (descriptors[i] < 0) { continue; }
+
+            // value, time enabled, time running
+            u64 values[3];
+            if (::read(descriptors[i], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+                continue;
+            }
+            counts[i] = values[2] < values[1] ?
+                u64(double(values[0]) * values[1] / values[2]) : values[0];
+        }
+        return counts;
+    }
+
+    void PerfCounters::report(const string& name) {
+        auto counts = read();
+        for (auto i = 0; i < PERF_EVENTS; i++) {
+            if (descriptors[i] >= 0) {
+                Metrics::global().count(name + "." + names[i], counts[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "defines.h"
+
+// # of hardware events counted per phase
+#define PERF_EVENTS 4
+
+namespace unbalanced_psi {
+
+    /**
+     * hardware performance counters (cycles, instructions, last level cache
+     *  misses and branch misses) for the calling thread and every thread it
+     *  starts afterwards, read through perf_event_open
+     */
+    class PerfCounters {
+
+        // file descriptor per event, -1 where it couldn't be opened
+        array<int, PERF_EVENTS> descriptors;
+
+        public:
+
+        // metric suffix for each event
+        static const array<string, PERF_EVENTS> names;
+
+        /**
+         * open and start the counters
+         */
+        PerfCounters();
+
+        /**
+         * close the counters
+         */
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        /**
+         * whether the kernel let us open any counter (see perf_event_paranoid)
+         */
+        bool available();
+
+        /**
+         * events counted since construction, scaled up where the kernel had to
+         *  multiplex the counters; entries that couldn't be opened are zero
+         */
+        array<u64, PERF_EVENTS> read();
+
+        /**
+         * add the current counts to <name>.<event> counters in the registry
+         */
+        void report(const string& name);
+    };
+}
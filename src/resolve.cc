@@ -0,0 +1,39 @@
+#include <cryptoTools/Common/CLP.h>
+
+#include "client.h"
+#include "resolver.h"
+
+using namespace unbalanced_psi;
+
+/**
+ * turn the buckets recovered by the pir client into the items of the
+ *  client's dataset in the intersection
+ */
+int main(int argc, char *argv[]) {
+    osuCrypto::CLP parser;
+	parser.parse(argc, argv);
+
+    Resolver resolver(parser.getOr<std::string>("-index", RESOLVER_INDEX_OUTPUT));
+    auto buckets = Resolver::read_buckets(
+        parser.getOr<std::string>("-recovered", RESOLVER_RECOVERED_INPUT)
+    );
+
+    // expected oprf output of each query, in the order they were made
+    auto results = read_dataset<u8>(parser.getOr<std::string>("-results", CLIENT_ONLINE_OUTPUT));
+    u64 entry_size = resolver.entry_bytes();
+    vector<hash_type> expected;
+    for (auto i = 0; entry_size > 0 && i + entry_size <= results.size(); i += entry_size) {
+        expected.emplace_back(results.begin() + i, results.begin() + i + entry_size);
+    }
+
+    // bucket each query asked the pir server for
+    auto queries = read_dataset<u64>(parser.getOr<std::string>("-queries", CLIENT_QUERY_OUTPUT));
+
+    Timer timer("[ client ] resolve", YELLOW);
+    auto intersection = resolver.resolve(expected, queries, buckets);
+    timer.stop();
+
+    std::cout << "[ client ] intersection size\t: " << intersection.size() << std::endl;
+    write_dataset(intersection, parser.getOr<std::string>("-output", RESOLVER_INTERSECTION_OUTPUT));
+    return 0;
+}
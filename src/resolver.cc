@@ -0,0 +1,143 @@
+#include "resolver.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace unbalanced_psi {
+
+    string Resolver::key(u64 bucket, const u8* output, u64 entry_size) {
+        string key(sizeof(u64) + entry_size, 0);
+        std::memcpy(key.data(), &bucket, sizeof(u64));
+        std::memcpy(key.data() + sizeof(u64), output, entry_size);
+        return key;
+    }
+
+    Resolver::Resolver(const vector<hash_type>& outputs, const vector<u64>& buckets, const vector<INPUT_TYPE>& items) :
+        entry_size(outputs.empty() ? 0 : outputs[0].size()) {
+
+        if (outputs.size() != items.size() || buckets.size() != items.size()) {
+            throw std::runtime_error("need exactly one oprf output and bucket per item");
+        }
+        index.reserve(outputs.size());
+        for (auto i = 0; i < outputs.size(); i++) {
+            index.emplace(key(buckets[i], outputs[i].data(), entry_size), items[i]);
+        }
+    }
+
+    Resolver::Resolver(string filename) {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+
+        u64 count;
+        file.read((char*) &entry_size, sizeof(u64));
+        file.read((char*) &count, sizeof(u64));
+        index.reserve(count);
+        for (auto i = 0; i < count; i++) {
+            INPUT_TYPE item;
+            string bucket_and_output(sizeof(u64) + entry_size, 0);
+            file.read((char*) &item, sizeof(INPUT_TYPE));
+            file.read(bucket_and_output.data(), bucket_and_output.size());
+            if (!file) { throw std::runtime_error("truncated resolver index " + filename); }
+            index.emplace(std::move(bucket_and_output), item);
+        }
+    }
+
+    bool Resolver::contains(const u8* bucket, u64 bucket_size, const u8* expected, u64 entry_size) {
+        u64 slots = bucket_size / entry_size;
+        u64 slot = 0;
+
+#if defined(__SSE2__)
+        if (entry_size <= RESOLVER_LANE_SIZE) {
+            // repeat expected across the lane so one compare covers every
+            //  whole slot in a lane that starts on a slot boundary
+            u64 per_lane = RESOLVER_LANE_SIZE / entry_size;
+            u8 pattern[RESOLVER_LANE_SIZE] = { 0 };
+            for (auto i = 0; i < per_lane * entry_size; i++) { pattern[i] = expected[i % entry_size]; }
+            __m128i needle = _mm_loadu_si128((const __m128i*) pattern);
+            u32 full = (u32(1) << entry_size) - 1;
+
+            for (; (slot * entry_size) + RESOLVER_LANE_SIZE <= bucket_size; slot += per_lane) {
+                __m128i lane = _mm_loadu_si128((const __m128i*) (bucket + slot * entry_size));
+                u32 equal = _mm_movemask_epi8(_mm_cmpeq_epi8(lane, needle));
+                for (auto i = 0; i < per_lane; i++) {
+                    if (((equal >> (i * entry_size)) & full) == full) { return true; }
+                }
+            }
+        }
+#endif
+
+        // whatever is left over (or everything without sse2)
+        for (; slot < slots; slot++) {
+            if (std::memcmp(bucket + slot * entry_size, expected, entry_size) == 0) { return true; }
+        }
+        return false;
+    }
+
+    std::optional<INPUT_TYPE> Resolver::resolve(const hash_type& expected, u64 query, const vector<u8>& bucket) {
+        if (!contains(bucket.data(), bucket.size(), expected.data(), expected.size())) {
+            return std::nullopt;
+        }
+        auto match = index.find(key(query, expected.data(), expected.size()));
+        if (match == index.end()) { return std::nullopt; }
+        return match->second;
+    }
+
+    vector<INPUT_TYPE> Resolver::resolve(
+        const vector<hash_type>& expected, const vector<u64>& queries, const vector<vector<u8>>& buckets
+    ) {
+        Phase resolving("client.resolve.compute");
+        if (expected.size() != buckets.size() || queries.size() != buckets.size()) {
+            throw std::runtime_error("need exactly one query and recovered bucket per expected output");
+        }
+
+        vector<INPUT_TYPE> intersection;
+        for (auto i = 0; i < expected.size(); i++) {
+            // blank queries were never answered
+            bool blank = std::all_of(expected[i].begin(), expected[i].end(), [](u8 b) { return b == 0; });
+            if (blank || buckets[i].empty()) { continue; }
+
+            auto item = resolve(expected[i], queries[i], buckets[i]);
+            if (item) { intersection.push_back(*item); }
+        }
+        Metrics::global().count("client.resolve.matches", intersection.size());
+        return intersection;
+    }
+
+    u64 Resolver::entry_bytes() {
+        return entry_size;
+    }
+
+    void Resolver::to_file(string filename) {
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+
+        u64 count = index.size();
+        file.write((const char*) &entry_size, sizeof(u64));
+        file.write((const char*) &count, sizeof(u64));
+        for (auto& [ bucket_and_output, item ] : index) {
+            file.write((const char*) &item, sizeof(INPUT_TYPE));
+            file.write(bucket_and_output.data(), bucket_and_output.size());
+        }
+        file.close();
+    }
+
+    vector<vector<u8>> Resolver::read_buckets(string filename) {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+
+        vector<vector<u8>> buckets;
+        u64 size;
+        while (file.read((char*) &size, sizeof(u64))) {
+            vector<u8> bucket(size);
+            if (!file.read((char*) bucket.data(), size)) {
+                throw std::runtime_error("truncated recovered buckets " + filename);
+            }
+            buckets.push_back(std::move(bucket));
+        }
+        return buckets;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+
+#include "defines.h"
+#include "utils.h"
+
+#define RESOLVER_INDEX_OUTPUT "out/client.index"
+#define RESOLVER_RECOVERED_INPUT "out/recovered.db"
+#define RESOLVER_INTERSECTION_OUTPUT "out/intersection.db"
+
+// # of bytes of a recovered bucket compared at once
+#define RESOLVER_LANE_SIZE 16
+
+namespace unbalanced_psi {
+
+    /**
+     * maps the pir buckets the client recovered back to the items of its own
+     *  dataset they match, keeping an index from each item's bucket and oprf
+     *  output (in the form the server stores it) to the item
+     */
+    class Resolver {
+
+        // number of bytes in each oprf output
+        u64 entry_size;
+
+        // bucket and oprf output to the client's item it came from (a
+        //  compacted output only identifies an item within its bucket)
+        std::unordered_map<string, INPUT_TYPE> index;
+
+        /**
+         * key of <output> stored in <bucket> in the index
+         */
+        static string key(u64 bucket, const u8* output, u64 entry_size);
+
+        public:
+
+        /**
+         * @params <outputs> oprf output of each item, as the server stores it
+         * @params <buckets> bucket of the server's hashtable each output is in
+         * @params <items>   the client's dataset, in the same order
+         */
+        Resolver(const vector<hash_type>& outputs, const vector<u64>& buckets, const vector<INPUT_TYPE>& items);
+
+        /**
+         * read an index written by to_file()
+         */
+        Resolver(string filename);
+
+        /**
+         * whether any whole <entry_size> slot of <bucket> equals <expected>,
+         *  comparing as many slots as fit in RESOLVER_LANE_SIZE bytes at once
+         */
+        static bool contains(const u8* bucket, u64 bucket_size, const u8* expected, u64 entry_size);
+
+        /**
+         * the item behind <expected> if it is in <bucket>, recovered from the
+         *  server's bucket number <query>
+         */
+        std::optional<INPUT_TYPE> resolve(const hash_type& expected, u64 query, const vector<u8>& bucket);
+
+        /**
+         * items in the intersection given each query's expected oprf output,
+         *  the bucket it asked for and the bucket recovered for it (blank
+         *  queries have all zero outputs)
+         */
+        vector<INPUT_TYPE> resolve(
+            const vector<hash_type>& expected, const vector<u64>& queries, const vector<vector<u8>>& buckets
+        );
+
+        /**
+         * number of bytes in each oprf output
+         */
+        u64 entry_bytes();
+
+        /**
+         * write the index to file
+         */
+        void to_file(string filename);
+
+        /**
+         * read the buckets the pir client recovered, each a u64 length
+         *  followed by that many bytes (zero for blank queries)
+         */
+        static vector<vector<u8>> read_buckets(string filename);
+    };
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include <coproto/Socket/LocalAsyncSock.h>
+#include <cryptoTools/Common/CLP.h>
+
+#include "client.h"
+#include "server.h"
+
+// average # of server entries per hashtable bucket, unless given a size
+#define SCALING_BUCKET_LOAD 16
+
+using namespace unbalanced_psi;
+
+// the stages timed on each trial
+const vector<string> STAGES = { "server_offline", "client_offline", "online" };
+
+/**
+ * seconds since <start>
+ */
+double since(const time_point<high_resolution_clock>& start) {
+    duration<double> elapsed = high_resolution_clock::now() - start;
+    return elapsed.count();
+}
+
+/**
+ * run the whole oprf once in this process, over an in-memory socket pair
+ *
+ * @return seconds spent in each of STAGES
+ */
+std::map<string, double> trial(
+    const vector<INPUT_TYPE>& server_db,
+    const vector<INPUT_TYPE>& client_db,
+    PSIParams params
+) {
+    std::map<string, double> seconds;
+    Server server(server_db, params);
+    Client client(client_db, params);
+
+    auto start = high_resolution_clock::now();
+    server.offline();
+    seconds["server_offline"] = since(start);
+
+    start = high_resolution_clock::now();
+    client.offline();
+    seconds["client_offline"] = since(start);
+
+    macoro::thread_pool pool;
+    auto work = pool.make_work();
+    pool.create_thread();
+
+    auto sockets = coproto::LocalAsyncSocket::makePair();
+    start = high_resolution_clock::now();
+    auto serving = std::async(std::launch::async, [&]() {
+        coproto::sync_wait(server.online(sockets[0], pool));
+    });
+    coproto::sync_wait(client.online(sockets[1]));
+    serving.get();
+    seconds["online"] = since(start);
+
+    work.reset();
+    pool.join();
+    return seconds;
+}
+
+double median(vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+    osuCrypto::CLP parser;
+	parser.parse(argc, argv);
+
+    auto logs = parser.getManyOr<u64>("-server-logs", { 16, 18, 20 });
+    auto thread_counts = parser.getManyOr<int>("-threads", { 1, 2, 4, 8 });
+    u64 client_size = 1 << parser.getOr<u64>("-client-log", 10);
+    int trials = parser.getOr<int>("-trials", 3);
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(6) << "{\n  \"results\": [";
+    bool first = true;
+
+    for (auto log : logs) {
+        u64 server_size = u64(1) << log;
+        auto [ server_db, client_db ] = generate_datasets(server_size, client_size, client_size / 2);
+
+        u64 hashtable_size = parser.getOr<u64>(
+            "-hashtable-size", std::max<u64>(1, server_size / SCALING_BUCKET_LOAD)
+        );
+
+        std::map<string, double> baseline;
+        for (auto threads : thread_counts) {
+            PSIParams params(
+                parser.getOr<u64>("-cuckoo-size", 1),
+                parser.getOr<u64>("-cuckoo-hashes", 0),
+                hashtable_size,
+                threads
+            );
+
+            std::map<string, vector<double>> samples;
+            for (auto i = 0; i < trials; i++) {
+                for (auto& [ stage, seconds ] : trial(server_db, client_db, params)) {
+                    samples[stage].push_back(seconds);
+                }
+            }
+
+            // speedup and efficiency are relative to the first thread count
+            for (auto& stage : STAGES) {
+                double seconds = median(samples[stage]);
+                if (threads == thread_counts[0]) { baseline[stage] = seconds; }
+                double speedup = baseline[stage] / seconds;
+                double efficiency = speedup * thread_counts[0] / threads;
+
+                std::cout << std::fixed << std::setprecision(3);
+                std::cout << "[ scale  ] 2^" << log << " " << stage << " t=" << threads;
+                std::cout << " (s)\t: " << seconds;
+                std::cout << "\tspeedup " << speedup << "\tefficiency " << efficiency << std::endl;
+
+                json << (first ? "\n" : ",\n");
+                json << "    { \"server_log\": " << log << ", \"stage\": \"" << stage << "\"";
+                json << ", \"threads\": " << threads << ", \"seconds\": " << seconds;
+                json << ", \"speedup\": " << speedup << ", \"efficiency\": " << efficiency << " }";
+                first = false;
+            }
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if (parser.isSet("-json")) {
+        std::ofstream file(parser.get<string>("-json"), std::ios::out);
+        if (!file) { throw std::runtime_error("cannot open " + parser.get<string>("-json")); }
+        file << json.str();
+    }
+    return 0;
+}
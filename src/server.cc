@@ -1,5 +1,9 @@
 #include "server.h"
 
+#include <algorithm>
+#include <set>
+#include <unordered_set>
+
 namespace unbalanced_psi {
 
     Server::Server(vector<INPUT_TYPE> db, PSIParams& p) : dataset(db), params(p) { }
@@ -8,92 +12,425 @@ namespace unbalanced_psi {
         dataset(read_dataset<INPUT_TYPE>(filename)), params(p) { }
 
     vector<Hashtable> Server::offline() {
-        // sample a random secret key
-        Point::MakeRandomNonzeroScalar(key);
+        keygen();
+        return bin();
+    }
 
+    vector<hash_type> Server::outputs(const Number& shared) {
+        key = shared;
 
-        // calculate the encrypted hash for each input
-        vector<hash_type> output;
-        if (params.threads == 1) {
-            output = encrypt(dataset.data(), dataset.size());
-        } else {
-            vector<future<vector<hash_type>>> futures(params.threads);
-
-            // encrypt elements in seperate threads
-            int batch = dataset.size() / params.threads + (dataset.size() % params.threads != 0);
-            for (auto i = 0; i < params.threads; i++) {
-                futures[i] = std::async(
-                    std::launch::async,
-                    &Server::encrypt,
-                    this,
-                    dataset.data() + (i * batch),
-                    i + 1 < params.threads ? batch : dataset.size() - (i * batch)
-                );
-            }
+        Phase encryption("server.offline.compute");
+        auto output = encrypt(dataset);
+        Metrics::global().count("server.offline.points", output.size());
+        return output;
+    }
+
+    u64 Server::use_epoch(OfflineCache& cache, bool rotate) {
+        key_epoch = cache.epoch(key, rotate);
+        return key_epoch;
+    }
 
-            for (auto i = 0; i < params.threads; i++) {
-                auto partial = futures[i].get();
-                output.insert(output.end(), partial.begin(), partial.end());
+    void Server::keygen(OfflineCache* c) {
+        cache = c;
+        cached.reset();
+        if (cache) {
+            digest = OfflineCache::digest(dataset, params, key_epoch);
+
+            vector<Hashtable> hashtables;
+            if (cache->load(digest, key, hashtables)) {
+                std::clog << "[ server ] loaded offline artifacts from cache" << std::endl;
+                cached = std::move(hashtables);
+                return;
             }
         }
 
+        // sample a random secret key, unless it's the epoch's
+        if (key_epoch == 0) { Point::MakeRandomNonzeroScalar(key); }
+    }
+
+    vector<Hashtable> Server::bin() {
+        if (cached) {
+            auto hashtables = std::move(*cached);
+            cached.reset();
+            return hashtables;
+        }
+
+        auto hashtables = build();
+        if (cache) { cache->store(digest, key, hashtables); }
+        return hashtables;
+    }
+
+    vector<Hashtable> Server::build() {
+        MemoryPhase memory("server.offline.memory");
+        Metrics::global().bytes("server.offline.dataset_bytes", dataset.size() * sizeof(INPUT_TYPE));
+
+        // calculate the encrypted hash for each input
+        Phase encryption("server.offline.compute");
+        vector<hash_type> output = encrypt(dataset);
+        encryption.stop();
+        Metrics::global().count("server.offline.points", output.size());
+        Metrics::global().bytes(
+            "server.offline.encrypted_bytes", output.size() * (sizeof(hash_type) + params.entry_size)
+        );
+
+        Phase binning("server.binning.compute");
+        vector<Hashtable> hashtables;
         if (params.cuckoo_size == 1) {
-            Hashtable hashtable(params.hashtable_size);
+            Hashtable hashtable(params.hashtable_size, params.compact);
             for (auto i = 0; i < output.size(); i++) {
                 hashtable.insert(output[i]);
             }
             hashtable.pad();
-            return vector<Hashtable>{hashtable};
+            hashtables.push_back(std::move(hashtable));
         } else {
             CuckooTable cuckoo(params);
             for (auto i = 0; i < output.size(); i++) {
                 cuckoo.insert(output[i]);
             }
             cuckoo.pad();
-            return cuckoo.table;
+            hashtables = std::move(cuckoo.table);
+        }
+        binning.stop();
+
+        u64 entries = 0, table_bytes = 0;
+        for (auto& hashtable : hashtables) {
+            entries += hashtable.size;
+            for (auto& bucket : hashtable.table) { table_bytes += bucket.size(); }
+        }
+        Metrics::global().count("server.binning.entries", entries);
+        Metrics::global().bytes("server.binning.table_bytes", table_bytes);
+        Metrics::global().bytes("server.binning.padding_bytes", table_bytes - entries * Hashtable::stored_size(params));
+        return hashtables;
+    }
+
+    vector<Hashtable> Server::offline(OfflineCache& cache) {
+        keygen(&cache);
+        return bin();
+    }
+
+    TableDelta Server::update(
+        vector<Hashtable>& hashtables,
+        const vector<INPUT_TYPE>& added,
+        const vector<INPUT_TYPE>& removed
+    ) {
+        MemoryPhase memory("server.update.memory");
+
+        // a repeat would pass the checks below against the old tables and
+        //  then go in (or come out) twice
+        if (std::unordered_set<INPUT_TYPE>(added.begin(), added.end()).size() != added.size()) {
+            throw std::runtime_error("adding the same element more than once");
+        }
+        if (std::unordered_set<INPUT_TYPE>(removed.begin(), removed.end()).size() != removed.size()) {
+            throw std::runtime_error("removing the same element more than once");
+        }
+
+        Phase encryption("server.update.compute");
+        auto added_outputs = encrypt(added);
+        auto removed_outputs = encrypt(removed);
+        encryption.stop();
+        Metrics::global().count("server.update.added", added.size());
+        Metrics::global().count("server.update.removed", removed.size());
+
+        // the hashtables an oprf output goes in
+        auto tables_of = [&](const hash_type& output) {
+            return params.cuckoo_size == 1 ?
+                vector<u64>{ 0 } :
+                CuckooTable::indexes(output, params.cuckoo_hashes, hashtables.size());
+        };
+
+        // check the whole update before changing anything
+        Phase binning("server.update.binning");
+        for (auto& output : removed_outputs) {
+            for (auto t : tables_of(output)) {
+                if (!hashtables[t].contains(output)) {
+                    throw std::runtime_error("removing an element that isn't in the dataset");
+                }
+            }
+        }
+        std::set<hash_type> removing(removed_outputs.begin(), removed_outputs.end());
+        for (auto& output : added_outputs) {
+            for (auto t : tables_of(output)) {
+                if (hashtables[t].contains(output) && removing.count(output) == 0) {
+                    throw std::runtime_error("adding an element that is already in the dataset");
+                }
+            }
+        }
+
+        vector<std::set<u64>> dirty(hashtables.size());
+        TableDelta delta;
+        delta.widened.resize(hashtables.size(), false);
+        for (auto& output : removed_outputs) {
+            for (auto t : tables_of(output)) {
+                hashtables[t].remove(output);
+                dirty[t].insert(Hashtable::hash(output, hashtables[t].buckets()));
+            }
         }
+        for (auto& output : added_outputs) {
+            for (auto t : tables_of(output)) {
+                if (hashtables[t].insert(output)) { delta.widened[t] = true; }
+                dirty[t].insert(Hashtable::hash(output, hashtables[t].buckets()));
+            }
+        }
+        binning.stop();
+
+        u64 dirty_buckets = 0;
+        for (auto& buckets : dirty) {
+            delta.dirty.emplace_back(buckets.begin(), buckets.end());
+            dirty_buckets += buckets.size();
+        }
+        Metrics::global().count("server.update.dirty_buckets", dirty_buckets);
+
+        // keep the dataset in step so size() and the cache digest follow it
+        std::unordered_set<INPUT_TYPE> leaving(removed.begin(), removed.end());
+        dataset.erase(
+            std::remove_if(dataset.begin(), dataset.end(), [&](INPUT_TYPE x) { return leaving.count(x) > 0; }),
+            dataset.end()
+        );
+        dataset.insert(dataset.end(), added.begin(), added.end());
+        return delta;
+    }
+
+    TableDelta Server::update(
+        vector<Hashtable>& hashtables,
+        const vector<INPUT_TYPE>& added,
+        const vector<INPUT_TYPE>& removed,
+        OfflineCache& cache
+    ) {
+        auto delta = update(hashtables, added, removed);
+        cache.store(OfflineCache::digest(dataset, params, key_epoch), key, hashtables);
+        return delta;
     }
 
-    vector<hash_type> Server::encrypt(INPUT_TYPE* elements, int size) {
+    void Server::to_file(string filename) {
+        write_dataset(dataset, filename);
+    }
+
+    vector<hash_type> Server::encrypt(const vector<INPUT_TYPE>& elements) {
+        if (params.threads == 1) {
+            return encrypt(elements.data(), elements.size());
+        }
+
+        // encrypt elements in seperate threads
+        vector<future<vector<hash_type>>> futures(params.threads);
+        int batch = elements.size() / params.threads + (elements.size() % params.threads != 0);
+        for (auto i = 0; i < params.threads; i++) {
+            int begin = std::min<int>(i * batch, elements.size());
+            int end = std::min<int>(begin + batch, elements.size());
+            futures[i] = std::async(
+                std::launch::async,
+                static_cast<vector<hash_type> (Server::*)(const INPUT_TYPE*, int)>(&Server::encrypt),
+                this,
+                elements.data() + begin,
+                end - begin
+            );
+        }
+
+        vector<hash_type> output;
+        for (auto i = 0; i < params.threads; i++) {
+            auto partial = futures[i].get();
+            output.insert(output.end(), partial.begin(), partial.end());
+        }
+        return output;
+    }
+
+    vector<hash_type> Server::encrypt(const INPUT_TYPE* elements, int size) {
         vector<hash_type> encrypted;
-        for (auto i = 0; i < size; i++) {
-            hash_type hashed(HASH_3_SIZE);
-            auto point = hash_to_group_element(*(elements + i));     // h(x)
-            point.scalar_multiply(key, true);                        // h(x)^a
-            hash_group_element(point, hashed.size(), hashed.data()); // g(h(x)^a)
-            encrypted.push_back(hashed);
+        encrypted.reserve(size);
+
+        vector<Point> points(HASH_BATCH_SIZE);
+        vector<u8> hashed(HASH_BATCH_SIZE * params.entry_size);
+        for (auto begin = 0; begin < size; begin += HASH_BATCH_SIZE) {
+            u64 count = std::min<u64>(HASH_BATCH_SIZE, size - begin);
+
+            hash_to_group_elements(elements + begin, count, points.data());    // h(x)
+            for (auto i = 0; i < count; i++) {
+                points[i].scalar_multiply(key, true);                          // h(x)^a
+            }
+            hash_group_elements(points.data(), count, params.entry_size, hashed.data()); // g(h(x)^a)
+
+            for (auto i = 0; i < count; i++) {
+                auto iter = hashed.begin() + i * params.entry_size;
+                encrypted.emplace_back(iter, iter + params.entry_size);
+            }
         }
         return encrypted;
     }
 
     void Server::online(Channel channel) {
+        vector<Channel> channels{channel};
+        online(channels);
+    }
+
+    void Server::online(vector<Channel>& all_channels) {
+        MemoryPhase memory("server.online.memory");
+
+        // tell the client which key its outputs will be under
+        all_channels[0].send(&key_epoch, 1);
+
+        // client only uses as many channels as it has points to fill, and
+        //  none when it has no points (or a coordinator has none for us)
+        u64 used;
+        all_channels[0].recv(&used, 1);
+        if (used > all_channels.size()) {
+            throw std::runtime_error("client asked for " + std::to_string(used) + " of "
+                + std::to_string(all_channels.size()) + " channels");
+        }
+        if (used == 0) { return; }
+        vector<Channel> channels(all_channels.begin(), all_channels.begin() + used);
+
+        vector<vector<u8>> requests(channels.size());
+        vector<vector<u8>> responses(channels.size());
+
         // receive client's encrypted dataset
-        vector<u8> request;
-        channel.recv(request);
+        vector<future<void>> futures(channels.size());
+        for (auto i = 0; i < channels.size(); i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                Phase receive("server.online.network");
+                channels[i].recv(requests[i]);
+                responses[i].resize(requests[i].size());
+            });
+        }
+        for (auto& f : futures) { f.get(); }
 
-        vector<u8> response(request.size());
+        u64 request_bytes = 0;
+        for (auto& request : requests) { request_bytes += request.size(); }
+        Metrics::global().bytes("server.online.request_bytes", request_bytes);
 
         Timer timer("[ server ] oprf online comp", BLUE);
+        Phase computation("server.online.compute");
 
-        // encrypt each point under the server's key
+        // encrypt each point under the server's key, sharing params.threads
+        //  between the channels
+        u64 threads = std::max<u64>(1, params.threads / channels.size());
+        for (auto i = 0; i < channels.size(); i++) {
+            auto evaluation = [&, i]() {
+                u64 count = requests[i].size() / Point::save_size;
+                if (batcher) {
+                    batcher->evaluate(requests[i].data(), responses[i].data(), count);
+                } else {
+                    evaluate_split(requests[i].data(), responses[i].data(), count, threads);
+                }
+            };
+            if (channels.size() == 1) {
+                evaluation();
+            } else {
+                futures[i] = std::async(std::launch::async, evaluation);
+            }
+        }
+        if (channels.size() > 1) {
+            for (auto& f : futures) { f.get(); }
+        }
+
+        computation.stop();
+        timer.stop();
+
+        for (auto i = 0; i < channels.size(); i++) {
+            futures[i] = std::async(std::launch::async, [&, i]() {
+                Phase send("server.online.network");
+                channels[i].send(responses[i]);
+            });
+        }
+        for (auto& f : futures) { f.get(); }
+    }
+
+    coproto::task<void> Server::online(coproto::Socket& socket, macoro::thread_pool& pool) {
+        MC_BEGIN(coproto::task<void>, this, &socket, &pool,
+            count = u64{},
+            request = vector<u8>{},
+            response = vector<u8>{}
+        );
+
+        // tell the client which key its outputs will be under
+        MC_AWAIT(socket.send(u64(key_epoch)));
+
+        // a client whose items all came from its cache has nothing to send
+        MC_AWAIT(socket.recv(count));
+
+        if (count != 0) {
+            // receive client's encrypted dataset
+            request.resize(count * Point::save_size);
+            MC_AWAIT(socket.recv(request));
+
+            response.resize(request.size());
+            if (batcher) {
+                // the batcher resumes the session once its batch is encrypted,
+                //  so waiting sessions don't each hold a pool thread
+                MC_AWAIT(batcher->evaluate_async(request.data(), response.data(), count));
+            } else {
+                // hop off of the networking thread for the heavy computation
+                MC_AWAIT(pool.schedule());
+
+                Phase computation("server.online.compute");
+                evaluate_split(request.data(), response.data(), count, params.threads);
+            }
+
+            MC_AWAIT(socket.send(std::move(response)));
+        }
+
+        MC_END();
+    }
+
+    void Server::evaluate(const u8* request, u8* response, u64 count) {
+        Metrics::global().count("server.online.points", count);
         Point point;
-        for (auto i = 0; i < request.size() / Point::save_size; i++) {
+        for (auto i = 0; i < count; i++) {
             point.load(Point::point_save_span_const_type{
-                request.data() + (i * Point::save_size),
+                request + (i * Point::save_size),
                 Point::save_size
             });
             point.scalar_multiply(key, true);
             point.save(Point::point_save_span_type{
-                response.data() + (i * Point::save_size),
+                response + (i * Point::save_size),
                 Point::save_size
             });
         }
+    }
 
-        timer.stop();
-        channel.send(response);
+    void Server::evaluate_split(const u8* request, u8* response, u64 count, u64 threads) {
+        if (threads <= 1) {
+            evaluate(request, response, count);
+            return;
+        }
+
+        // evaluate in seperate threads
+        u64 batch = count / threads + (count % threads != 0);
+        vector<future<void>> futures;
+        for (u64 begin = 0; begin < count; begin += batch) {
+            u64 size = std::min(batch, count - begin);
+            futures.push_back(std::async(
+                std::launch::async, &Server::evaluate, this,
+                request + begin * Point::save_size,
+                response + begin * Point::save_size,
+                size
+            ));
+        }
+        for (auto& f : futures) { f.get(); }
+    }
+
+    void Server::batch(u64 max_points, u64 max_delay) {
+        batcher = std::make_unique<OPRFBatcher>(
+            [this](const u8* input, u8* output, u64 count) { evaluate(input, output, count); },
+            params.threads, max_points, max_delay
+        );
     }
 
     int Server::size() {
         return dataset.size();
     }
+
+    void TableDelta::to_file(string filename) {
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+        if (!file) { throw std::runtime_error("cannot open " + filename); }
+
+        u64 count = dirty.size();
+        file.write((const char*) &count, sizeof(u64));
+        for (auto i = 0; i < dirty.size(); i++) {
+            u64 grew = widened[i];
+            u64 buckets = dirty[i].size();
+            file.write((const char*) &grew, sizeof(u64));
+            file.write((const char*) &buckets, sizeof(u64));
+            file.write((const char*) dirty[i].data(), buckets * sizeof(u64));
+        }
+        file.close();
+    }
 }
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+
 #include "defines.h"
+#include "batcher.h"
+#include "cache.h"
 #include "cuckoo.h"
 #include "hashtable.h"
 #include "utils.h"
@@ -16,10 +21,30 @@
 #define SERVER_OFFLINE_OUTPUT_PREFIX "out/"
 #define SERVER_OFFLINE_OUTPUT_SUFFIX "/server.edb"
 
+#define SERVER_UPDATE_OUTPUT "out/server.delta"
+
 namespace unbalanced_psi {
 
     using hash_type = vector<u8>;
 
+    /**
+     * what an update changed in each of the server's hashtables
+     */
+    struct TableDelta {
+
+        // buckets of each hashtable whose entries changed, in order
+        vector<vector<u64>> dirty;
+
+        // whether each hashtable's width grew, which changes every bucket
+        vector<bool> widened;
+
+        /**
+         * write to file: the number of hashtables, then for each one whether
+         *  it widened, the number of dirty buckets and their indexes (all u64)
+         */
+        void to_file(string filename);
+    };
+
     class Server {
 
         // server's dataset
@@ -28,9 +53,24 @@ namespace unbalanced_psi {
         // secret key
         Number key;
 
+        // id of the key epoch the secret key belongs to, announced to clients
+        //  so they can reuse outputs from earlier runs (0 if it's sampled
+        //  every run)
+        u64 key_epoch = 0;
+
         // parameters for psi protocol
         PSIParams params;
 
+        // shares oprf evaluation between concurrent client sessions
+        std::unique_ptr<OPRFBatcher> batcher;
+
+        // where keygen() looked for the key and hashtables, if anywhere
+        OfflineCache* cache = nullptr;
+        cache_digest digest;
+
+        // hashtables keygen() found in the cache, for bin() to hand back
+        std::optional<vector<Hashtable>> cached;
+
         public:
 
         /**
@@ -56,6 +96,81 @@ namespace unbalanced_psi {
          */
         vector<Hashtable> offline();
 
+        /**
+         * same as offline() but reuse the key and hashtables from the cache
+         *  when they were computed from this dataset and these parameters
+         *
+         * @params <cache> cached artifacts from previous runs
+         */
+        vector<Hashtable> offline(OfflineCache& cache);
+
+        /**
+         * offline() in two steps: keygen() samples the secret key (or loads it
+         *  and the hashtables from the cache), which is all online() needs,
+         *  so the client can be answered while bin() builds the hashtables
+         *
+         * @params <cache> cached artifacts from previous runs (optional)
+         */
+        void keygen(OfflineCache* cache = nullptr);
+
+        /**
+         * take the secret key from the cache's current key epoch (starting a
+         *  new one if <rotate> is set) rather than sampling one in keygen()
+         *
+         * @params <cache> cache holding the epoch's sealed key
+         * @params <rotate> whether to move on to a new epoch and key
+         * @return id of the epoch
+         */
+        u64 use_epoch(OfflineCache& cache, bool rotate = false);
+
+        /**
+         * encrypt dataset under the key from keygen() and prepare hashtable,
+         *  storing them in the cache keygen() was given (or just return the
+         *  cached ones)
+         */
+        vector<Hashtable> bin();
+
+        /**
+         * encrypt the dataset under a secret key shared with other servers,
+         *  leaving the outputs for whichever server holds their hashtables
+         *
+         * @params <shared> secret key to encrypt under
+         * @return the oprf output of each element, in dataset order
+         */
+        vector<hash_type> outputs(const Number& shared);
+
+        /**
+         * add and remove elements of the dataset after offline(), encrypting
+         *  only the new ones under the existing key and changing only the
+         *  buckets they hash to
+         *
+         * @params <hashtables> tables returned by offline(), updated in place
+         * @params <added> distinct elements not yet in the dataset
+         * @params <removed> distinct elements of the dataset, taken out before adding
+         * @return the buckets that changed
+         */
+        TableDelta update(
+            vector<Hashtable>& hashtables,
+            const vector<INPUT_TYPE>& added,
+            const vector<INPUT_TYPE>& removed
+        );
+
+        /**
+         * same as above, then store the updated tables in the cache so the
+         *  next run on the updated dataset can load them
+         */
+        TableDelta update(
+            vector<Hashtable>& hashtables,
+            const vector<INPUT_TYPE>& added,
+            const vector<INPUT_TYPE>& removed,
+            OfflineCache& cache
+        );
+
+        /**
+         * write the (updated) dataset to file
+         */
+        void to_file(string filename);
+
         /**
          * reply to encryption request on client's set
          *
@@ -64,6 +179,33 @@ namespace unbalanced_psi {
          */
         void online(Channel channel);
 
+        /**
+         * reply to an encryption request split across several channels,
+         *  handling each channel's share of the points on its own thread
+         *  (a request over no channels has nothing to answer)
+         *
+         * @params <channels> communication channels with the client
+         */
+        void online(vector<Channel>& channels);
+
+        /**
+         * same as above but as a coroutine, which leaves the networking
+         *  thread to other client sessions while the points are encrypted
+         *
+         * @params <socket> coproto connection with the client
+         * @params <pool> threads to encrypt on when not batching
+         */
+        coproto::task<void> online(coproto::Socket& socket, macoro::thread_pool& pool);
+
+        /**
+         * coalesce the points of concurrent online() calls into shared
+         *  batches evaluated across all threads (call after offline)
+         *
+         * @params <max_points> stop waiting once this many points are queued
+         * @params <max_delay> microseconds a request may wait for others
+         */
+        void batch(u64 max_points = BATCH_MAX_POINTS, u64 max_delay = BATCH_MAX_DELAY);
+
         /**
          * @return number of elements in the dataset
          */
@@ -71,9 +213,29 @@ namespace unbalanced_psi {
 
         private:
 
+        /**
+         * encrypt dataset under the secret key and prepare hashtable
+         */
+        vector<Hashtable> build();
+
+        /**
+         * encrypt elements split across params.threads threads
+         */
+        vector<hash_type> encrypt(const vector<INPUT_TYPE>& elements);
+
         /**
          * hash given input to group elements and encrypt under the secret key
          */
-        vector<hash_type> encrypt(INPUT_TYPE* elements, int size);
+        vector<hash_type> encrypt(const INPUT_TYPE* elements, int size);
+
+        /**
+         * encrypt each of the client's serialized points under the secret key
+         */
+        void evaluate(const u8* request, u8* response, u64 count);
+
+        /**
+         * same as evaluate() but split evenly across <threads> threads
+         */
+        void evaluate_split(const u8* request, u8* response, u64 count, u64 threads);
     };
 }
@@ -0,0 +1,232 @@
+#include "shaper.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace unbalanced_psi {
+
+    /**
+     * split "ip:port" into a socket address
+     */
+    static sockaddr_in parse_address(const string& address) {
+        auto colon = address.rfind(':');
+        if (colon == string::npos) { throw std::runtime_error("expected ip:port, got " + address); }
+
+        sockaddr_in parsed{};
+        parsed.sin_family = AF_INET;
+        parsed.sin_port = htons(std::stoi(address.substr(colon + 1)));
+        if (inet_pton(AF_INET, address.substr(0, colon).c_str(), &parsed.sin_addr) != 1) {
+            throw std::runtime_error("invalid address " + address);
+        }
+        return parsed;
+    }
+
+    static void no_delay(int socket) {
+        int on = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    Shaper::Shaper(string listen, string t, LinkParams l) :
+        link(l), target(t), stopping(false), sent(0), received(0), delay_ns(0) {
+
+        auto address = parse_address(listen);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(listener, (sockaddr*) &address, sizeof(address)) != 0 || ::listen(listener, 64) != 0) {
+            close(listener);
+            throw std::runtime_error("shaper cannot listen on " + listen);
+        }
+
+        socklen_t length = sizeof(address);
+        getsockname(listener, (sockaddr*) &address, &length);
+        listen_port = ntohs(address.sin_port);
+
+        acceptor = std::thread(&Shaper::accept, this);
+    }
+
+    Shaper::~Shaper() {
+        stopping = true;
+        shutdown(listener, SHUT_RDWR);
+        acceptor.join();
+        close(listener);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto socket : sockets) { shutdown(socket, SHUT_RDWR); }
+        }
+        for (auto& thread : threads) { thread.join(); }
+        for (auto socket : sockets) { close(socket); }
+    }
+
+    u16 Shaper::port() {
+        return listen_port;
+    }
+
+    u64 Shaper::bytes_sent() {
+        return sent;
+    }
+
+    u64 Shaper::bytes_received() {
+        return received;
+    }
+
+    double Shaper::delayed() {
+        return delay_ns / 1e9;
+    }
+
+    u64 Shaper::in_flight_limit() {
+        if (link.bandwidth <= 0) { return 0; }
+
+        // never so small that a single chunk can't get through
+        double product = link.bandwidth * 1e6 / 8 * link.rtt / 1e3;
+        return std::max<u64>(product, SHAPER_CHUNK_SIZE);
+    }
+
+    void Shaper::accept() {
+        while (!stopping) {
+            int incoming = ::accept(listener, nullptr, nullptr);
+            if (incoming < 0) { continue; }
+
+            int outgoing;
+            try {
+                outgoing = connect_target();
+            } catch (const std::exception& e) {
+                std::cerr << "[ shaper ] " << e.what() << std::endl;
+                close(incoming);
+                continue;
+            }
+            no_delay(incoming);
+            no_delay(outgoing);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            sockets.push_back(incoming);
+            sockets.push_back(outgoing);
+
+            pipes.push_back(std::make_unique<Pipe>());
+            auto upstream = pipes.back().get();
+            upstream->from = incoming;
+            upstream->to = outgoing;
+            upstream->counter = &sent;
+
+            pipes.push_back(std::make_unique<Pipe>());
+            auto downstream = pipes.back().get();
+            downstream->from = outgoing;
+            downstream->to = incoming;
+            downstream->counter = &received;
+
+            for (auto pipe : { upstream, downstream }) {
+                threads.emplace_back(&Shaper::read, this, pipe);
+                threads.emplace_back(&Shaper::write, this, pipe);
+            }
+        }
+    }
+
+    void Shaper::read(Pipe* pipe) {
+        std::mt19937_64 random(std::random_device{}());
+        std::normal_distribution<double> jitter(0, link.jitter);
+        clock::time_point last_release;
+        u64 limit = in_flight_limit();
+
+        vector<u8> buffer(SHAPER_CHUNK_SIZE);
+        while (true) {
+            // stop reading while the link is full, so the sender's window fills up
+            if (limit > 0) {
+                std::unique_lock<std::mutex> lock(pipe->mutex);
+                pipe->room.wait(lock, [&]() { return pipe->broken || pipe->queued + buffer.size() <= limit; });
+                if (pipe->broken) { break; }
+            }
+
+            ssize_t n = recv(pipe->from, buffer.data(), buffer.size(), 0);
+            if (n <= 0) { break; }
+            auto arrival = clock::now();
+
+            // time on the wire at the emulated bandwidth, queued behind earlier chunks
+            auto serialization = link.bandwidth > 0 ?
+                std::chrono::duration<double>(n * 8 / (link.bandwidth * 1e6)) :
+                std::chrono::duration<double>(0);
+            pipe->link_free = std::max(pipe->link_free, arrival) +
+                std::chrono::duration_cast<clock::duration>(serialization);
+
+            // tcp delivers in order, so jitter can't let a chunk overtake another
+            double one_way = std::max(0.0, link.rtt / 2 + (link.jitter > 0 ? jitter(random) : 0));
+            auto release = pipe->link_free + std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double, std::milli>(one_way)
+            );
+            release = std::max(release, last_release);
+            last_release = release;
+
+            *pipe->counter += n;
+            delay_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(release - arrival).count();
+            {
+                std::lock_guard<std::mutex> lock(pipe->mutex);
+                pipe->chunks.emplace_back(release, vector<u8>(buffer.begin(), buffer.begin() + n));
+                pipe->queued += n;
+            }
+            pipe->ready.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pipe->mutex);
+            pipe->closed = true;
+        }
+        pipe->ready.notify_one();
+    }
+
+    void Shaper::write(Pipe* pipe) {
+        while (true) {
+            tuple<clock::time_point, vector<u8>> chunk;
+            {
+                std::unique_lock<std::mutex> lock(pipe->mutex);
+                pipe->ready.wait(lock, [pipe]() { return pipe->closed || !pipe->chunks.empty(); });
+                if (pipe->chunks.empty()) { break; }
+                chunk = std::move(pipe->chunks.front());
+                pipe->chunks.pop_front();
+            }
+
+            std::this_thread::sleep_until(std::get<0>(chunk));
+
+            auto& data = std::get<1>(chunk);
+            u64 written = 0;
+            while (written < data.size()) {
+                ssize_t n = send(pipe->to, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    // let a reader waiting for room give up too
+                    {
+                        std::lock_guard<std::mutex> lock(pipe->mutex);
+                        pipe->broken = true;
+                    }
+                    pipe->room.notify_one();
+                    return;
+                }
+                written += n;
+            }
+            {
+                std::lock_guard<std::mutex> lock(pipe->mutex);
+                pipe->queued -= data.size();
+            }
+            pipe->room.notify_one();
+        }
+
+        // pass the half-close along once everything before it is delivered
+        shutdown(pipe->to, SHUT_WR);
+    }
+
+    int Shaper::connect_target() {
+        auto address = parse_address(target);
+        auto deadline = clock::now() + std::chrono::milliseconds(SHAPER_CONNECT_TIMEOUT);
+        while (!stopping && clock::now() < deadline) {
+            int outgoing = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(outgoing, (sockaddr*) &address, sizeof(address)) == 0) {
+                return outgoing;
+            }
+            close(outgoing);
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        throw std::runtime_error("shaper cannot connect to " + target);
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "defines.h"
+
+// where the client's end of the shaping proxy listens by default
+#define SHAPER_ADDRESS "127.0.0.1:1214"
+
+// most bytes read off a socket at once (and so queued as one chunk)
+#define SHAPER_CHUNK_SIZE (1 << 16)
+
+// how long to keep retrying a connection to the real server (milliseconds)
+#define SHAPER_CONNECT_TIMEOUT 30000
+
+namespace unbalanced_psi {
+
+    /**
+     * link conditions the proxy emulates
+     */
+    struct LinkParams {
+        // bandwidth in each direction in megabits per second (0 for unlimited)
+        double bandwidth;
+
+        // round trip time in milliseconds
+        double rtt;
+
+        // standard deviation of the one-way delay in milliseconds
+        double jitter;
+
+        LinkParams(double bw, double r, double j) : bandwidth(bw), rtt(r), jitter(j) { }
+    };
+
+    /**
+     * tcp proxy which forwards every connection it accepts to a target
+     *  address, holding each chunk back for as long as it would take to cross
+     *  a link with the given bandwidth, latency and jitter
+     *
+     * a limited link holds at most about one bandwidth-delay product in
+     *  flight per direction, so a fast sender is slowed down the way a real
+     *  link's window would, instead of the proxy buffering everything
+     */
+    class Shaper {
+
+        public:
+
+        /**
+         * start accepting connections
+         *
+         * @params <listen> ip:port to accept on (port 0 picks a free one)
+         * @params <target> ip:port to forward each connection to
+         * @params <link> conditions to emulate
+         */
+        Shaper(string listen, string target, LinkParams link);
+
+        /**
+         * stop accepting, and tear down every forwarded connection
+         */
+        ~Shaper();
+
+        /**
+         * port the proxy is listening on
+         */
+        u16 port();
+
+        /**
+         * bytes forwarded towards the target and back towards the connector
+         */
+        u64 bytes_sent();
+        u64 bytes_received();
+
+        /**
+         * total seconds chunks were held back beyond when they arrived
+         */
+        double delayed();
+
+        /**
+         * most bytes held in flight in each direction (0 for no limit)
+         */
+        u64 in_flight_limit();
+
+        private:
+
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * one direction of a forwarded connection
+         */
+        struct Pipe {
+            int from;
+            int to;
+            std::atomic<u64>* counter;
+
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::condition_variable room;
+            std::deque<tuple<clock::time_point, vector<u8>>> chunks;
+            bool closed = false;
+
+            // bytes read but not yet written, and whether the writer gave up
+            u64 queued = 0;
+            bool broken = false;
+
+            // when the emulated link finishes serializing the last chunk
+            clock::time_point link_free;
+        };
+
+        LinkParams link;
+        string target;
+        int listener;
+        u16 listen_port;
+        std::atomic<bool> stopping;
+
+        std::atomic<u64> sent;
+        std::atomic<u64> received;
+        std::atomic<u64> delay_ns;
+
+        std::mutex mutex;
+        vector<int> sockets;
+        vector<std::unique_ptr<Pipe>> pipes;
+        vector<std::thread> threads;
+        std::thread acceptor;
+
+        /**
+         * accept connections and start forwarding them until stopped
+         */
+        void accept();
+
+        /**
+         * read chunks off a pipe's source, stamping when each may be released
+         */
+        void read(Pipe* pipe);
+
+        /**
+         * write chunks to a pipe's destination once they are released
+         */
+        void write(Pipe* pipe);
+
+        /**
+         * connect to the target, retrying while it isn't up yet
+         */
+        int connect_target();
+    };
+}
@@ -1,7 +1,14 @@
 #include <cryptoTools/Common/TestCollection.h>
 
+#include "test_batcher.h"
+#include "test_cache.h"
 #include "test_cuckoo.h"
+#include "test_generator.h"
 #include "test_hashtable.h"
+#include "test_metrics.h"
+#include "test_online.h"
+#include "test_resolver.h"
+#include "test_shaper.h"
 #include "test_utils.h"
 
 using namespace unbalanced_psi;
@@ -12,17 +19,32 @@ int main() {
         th.add("test_generate_datasets_overlap    ", test_generate_datasets_overlap);
         th.add("test_write_read_dataset           ", test_write_read_dataset);
         th.add("test_read_dataset                 ", test_read_dataset);
+        th.add("test_permutation_bijective        ", test_permutation_bijective);
+        th.add("test_generator_exact_overlap      ", test_generator_exact_overlap);
+        th.add("test_generator_reproducible       ", test_generator_reproducible);
+        th.add("test_generator_write              ", test_generator_write);
         th.add("test_hash_to_group_element_same   ", test_hash_to_group_element_same);
         th.add("test_hash_to_group_element_diff   ", test_hash_to_group_element_diff);
         th.add("test_hash_group_element_same      ", test_hash_group_element_same);
         th.add("test_hash_group_element_diff      ", test_hash_group_element_diff);
+        th.add("test_hash_to_group_elements_batch ", test_hash_to_group_elements_batch);
+        th.add("test_hash_group_elements_batch    ", test_hash_group_elements_batch);
+        th.add("test_blake2b_many                 ", test_blake2b_many);
+        th.add("test_false_positive_bound         ", test_false_positive_bound);
         th.add("test_hash_repeat                  ", test_hash_repeat);
         th.add("test_hash_range                   ", test_hash_range);
+        th.add("test_hash_short_entry             ", test_hash_short_entry);
         th.add("test_hashtable_insert_one         ", test_hashtable_insert_one);
         th.add("test_hashtable_insert_many        ", test_hashtable_insert_many);
         th.add("test_hashtable_pad_empty          ", test_hashtable_pad_empty);
         th.add("test_hashtable_pad_one            ", test_hashtable_pad_one);
         th.add("test_hashtable_pad_many           ", test_hashtable_pad_many);
+        th.add("test_hashtable_merge              ", test_hashtable_merge);
+        th.add("test_hashtable_compact_round_trip ", test_hashtable_compact_round_trip);
+        th.add("test_hashtable_compact_insert     ", test_hashtable_compact_insert);
+        th.add("test_hashtable_remove             ", test_hashtable_remove);
+        th.add("test_hashtable_insert_padded      ", test_hashtable_insert_padded);
+        th.add("test_hashtable_sparse_file        ", test_hashtable_sparse_file);
         th.add("test_cuckoo_hash_repeat           ", test_cuckoo_hash_repeat);
         th.add("test_cuckoo_hash_diff             ", test_cuckoo_hash_diff);
         th.add("test_cuckoo_table_insert_one      ", test_cuckoo_table_insert_one);
@@ -31,6 +53,36 @@ int main() {
         th.add("test_cuckoo_vector_insert_many    ", test_cuckoo_vector_insert_many);
         th.add("test_cuckoo_vector_insert_overfill", test_cuckoo_vector_insert_overfill);
         th.add("test_cuckoo_failure_rate          ", test_cuckoo_failure_rate);
+        th.add("test_cache_store_load             ", test_cache_store_load);
+        th.add("test_cache_digest_mismatch        ", test_cache_digest_mismatch);
+        th.add("test_cache_wrong_sealing_key      ", test_cache_wrong_sealing_key);
+        th.add("test_cache_tampered_tables        ", test_cache_tampered_tables);
+        th.add("test_cache_epoch                  ", test_cache_epoch);
+        th.add("test_result_cache                 ", test_result_cache);
+        th.add("test_batcher_single_request       ", test_batcher_single_request);
+        th.add("test_batcher_concurrent_requests  ", test_batcher_concurrent_requests);
+        th.add("test_batcher_coalesces            ", test_batcher_coalesces);
+        th.add("test_batcher_awaitable            ", test_batcher_awaitable);
+        th.add("test_metrics_name                 ", test_metrics_name);
+        th.add("test_metrics_accumulate           ", test_metrics_accumulate);
+        th.add("test_metrics_json                 ", test_metrics_json);
+        th.add("test_metrics_memory_phase         ", test_metrics_memory_phase);
+        th.add("test_metrics_nested_memory_phases ", test_metrics_nested_memory_phases);
+        th.add("test_metrics_hardware_counters    ", test_metrics_hardware_counters);
+        th.add("test_resolver_contains            ", test_resolver_contains);
+        th.add("test_resolver_resolve             ", test_resolver_resolve);
+        th.add("test_resolver_same_compacted      ", test_resolver_same_compacted);
+        th.add("test_resolver_file                ", test_resolver_file);
+        th.add("test_shaper_forwards              ", test_shaper_forwards);
+        th.add("test_shaper_latency               ", test_shaper_latency);
+        th.add("test_shaper_bandwidth             ", test_shaper_bandwidth);
+        th.add("test_shaper_in_flight             ", test_shaper_in_flight);
+        th.add("test_online_intersection          ", test_online_intersection);
+        th.add("test_online_sharded               ", test_online_sharded);
+        th.add("test_shard_tables                 ", test_shard_tables);
+        th.add("test_shard_pack_outputs           ", test_shard_pack_outputs);
+        th.add("test_online_all_cached            ", test_online_all_cached);
+        th.add("test_online_async_all_cached      ", test_online_async_all_cached);
     });
 
     tests.runAll();
@@ -0,0 +1,140 @@
+#include "test_batcher.h"
+
+#include <atomic>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../batcher.h"
+#include "../utils.h"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    // stand-in for encryption which is easy to check
+    void mock_evaluate(const u8* input, u8* output, u64 count) {
+        for (auto i = 0; i < count * Point::save_size; i++) {
+            output[i] = input[i] ^ 0xFF;
+        }
+    }
+
+    vector<u8> mock_points(u64 count, u8 seed) {
+        vector<u8> points(count * Point::save_size);
+        for (auto i = 0; i < points.size(); i++) {
+            points[i] = u8(i * 7 + seed);
+        }
+        return points;
+    }
+
+    void check_mock_response(const vector<u8>& request, const vector<u8>& response) {
+        for (auto i = 0; i < request.size(); i++) {
+            if (response[i] != (request[i] ^ 0xFF)) {
+                throw UnitTestFail("response byte " + std::to_string(i) + " not evaluated");
+            }
+        }
+    }
+
+    void test_batcher_single_request() {
+        OPRFBatcher batcher(mock_evaluate, 2, 1024, 100);
+
+        auto request = mock_points(5, 1);
+        vector<u8> response(request.size());
+        batcher.evaluate(request.data(), response.data(), 5);
+
+        check_mock_response(request, response);
+    }
+
+    void test_batcher_concurrent_requests() {
+        u64 SESSIONS = 8;
+        OPRFBatcher batcher(mock_evaluate, 3, 64, 1000);
+
+        vector<vector<u8>> requests, responses;
+        for (auto i = 0; i < SESSIONS; i++) {
+            requests.push_back(mock_points(i * 13 + 1, u8(i)));
+            responses.emplace_back(requests.back().size());
+        }
+
+        vector<future<void>> futures;
+        for (auto i = 0; i < SESSIONS; i++) {
+            futures.push_back(std::async(std::launch::async, [&, i]() {
+                batcher.evaluate(
+                    requests[i].data(), responses[i].data(),
+                    requests[i].size() / Point::save_size
+                );
+            }));
+        }
+        for (auto& f : futures) { f.get(); }
+
+        for (auto i = 0; i < SESSIONS; i++) {
+            check_mock_response(requests[i], responses[i]);
+        }
+    }
+
+    void test_batcher_coalesces() {
+        u64 SESSIONS = 4;
+        std::atomic<u64> calls(0);
+
+        // a long delay means every session should make it into one batch
+        OPRFBatcher batcher(
+            [&](const u8* input, u8* output, u64 count) {
+                calls++;
+                mock_evaluate(input, output, count);
+            },
+            1, 1 << 20, 500000
+        );
+
+        vector<vector<u8>> requests, responses;
+        for (auto i = 0; i < SESSIONS; i++) {
+            requests.push_back(mock_points(4, u8(i)));
+            responses.emplace_back(requests.back().size());
+        }
+
+        vector<future<void>> futures;
+        for (auto i = 0; i < SESSIONS; i++) {
+            futures.push_back(std::async(std::launch::async, [&, i]() {
+                batcher.evaluate(requests[i].data(), responses[i].data(), 4);
+            }));
+        }
+        for (auto& f : futures) { f.get(); }
+
+        if (calls >= SESSIONS) {
+            throw UnitTestFail("concurrent requests were never batched together");
+        }
+    }
+
+    // stands in for a coroutine handle, recording when it's resumed
+    struct MockHandle {
+        std::promise<void>* resumed;
+        void resume() { resumed->set_value(); }
+    };
+
+    void test_batcher_awaitable() {
+        u64 SESSIONS = 6;
+        OPRFBatcher batcher(mock_evaluate, 2, 1 << 20, 1000);
+
+        vector<vector<u8>> requests, responses;
+        vector<std::promise<void>> resumed(SESSIONS);
+        vector<OPRFBatcher::Evaluation> evaluations;
+        for (auto i = 0; i < SESSIONS; i++) {
+            requests.push_back(mock_points(i + 1, u8(i)));
+            responses.emplace_back(requests.back().size());
+        }
+
+        // every session suspends from this one thread without blocking it
+        for (auto i = 0; i < SESSIONS; i++) {
+            evaluations.push_back(batcher.evaluate_async(requests[i].data(), responses[i].data(), i + 1));
+        }
+        for (auto i = 0; i < SESSIONS; i++) {
+            if (evaluations[i].await_ready()) {
+                throw UnitTestFail("a non-empty evaluation was ready before it was queued");
+            }
+            evaluations[i].await_suspend(MockHandle{&resumed[i]});
+        }
+
+        for (auto i = 0; i < SESSIONS; i++) {
+            resumed[i].get_future().get();
+            evaluations[i].await_resume();
+            check_mock_response(requests[i], responses[i]);
+        }
+    }
+}
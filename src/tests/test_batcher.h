@@ -0,0 +1,8 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_batcher_single_request();
+    void test_batcher_concurrent_requests();
+    void test_batcher_coalesces();
+    void test_batcher_awaitable();
+}
@@ -0,0 +1,234 @@
+#include "test_cache.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../cache.h"
+#include "../utils.h"
+
+#define CACHE_DIRECTORY "/tmp"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    Hashtable cached_hashtable() {
+        Hashtable hashtable(16);
+        for (INPUT_TYPE i = 0; i < 32; i++) {
+            Point encrypted = hash_to_group_element(i);
+            vector<u8> hashed(HASH_3_SIZE);
+            hash_group_element(encrypted, hashed.size(), hashed.data());
+            hashtable.insert(hashed);
+        }
+        hashtable.pad();
+        return hashtable;
+    }
+
+    void test_cache_store_load() {
+        PSIParams PARAMS(16, 1);
+        auto dataset = generate_dataset(32);
+        auto digest = OfflineCache::digest(dataset, PARAMS);
+
+        Number key;
+        Point::MakeRandomNonzeroScalar(key);
+        vector<Hashtable> expected{cached_hashtable()};
+
+        OfflineCache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_store_load.key").store(digest, key, expected);
+
+        Number actual_key;
+        vector<Hashtable> actual;
+        OfflineCache cache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_store_load.key");
+        if (!cache.load(digest, actual_key, actual)) {
+            throw UnitTestFail("cache missed for the same digest");
+        }
+
+        if (actual_key != key) {
+            throw UnitTestFail("secret key changed through the cache");
+        }
+        if (actual.size() != 1 || actual[0].table != expected[0].table
+                || actual[0].width != expected[0].width || actual[0].size != expected[0].size
+                || actual[0].occupancy != expected[0].occupancy) {
+            throw UnitTestFail("hashtable changed through the cache");
+        }
+    }
+
+    void test_cache_digest_mismatch() {
+        auto dataset = generate_dataset(32);
+        PSIParams PARAMS(16, 1);
+        PSIParams OTHER(32, 1);
+
+        Number key;
+        Point::MakeRandomNonzeroScalar(key);
+
+        OfflineCache cache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_digest_mismatch.key");
+        cache.store(OfflineCache::digest(dataset, PARAMS), key, vector<Hashtable>{cached_hashtable()});
+
+        vector<Hashtable> tables;
+        if (cache.load(OfflineCache::digest(dataset, OTHER), key, tables)) {
+            throw UnitTestFail("cache hit even though the params changed");
+        }
+
+        dataset[0]++;
+        if (cache.load(OfflineCache::digest(dataset, PARAMS), key, tables)) {
+            throw UnitTestFail("cache hit even though the dataset changed");
+        }
+    }
+
+    void test_cache_wrong_sealing_key() {
+        auto dataset = generate_dataset(32);
+        auto digest = OfflineCache::digest(dataset, PSIParams(16, 1));
+
+        Number key;
+        Point::MakeRandomNonzeroScalar(key);
+
+        std::remove(CACHE_DIRECTORY "/test_wrong_sealing_a.key");
+        std::remove(CACHE_DIRECTORY "/test_wrong_sealing_b.key");
+        OfflineCache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_wrong_sealing_a.key")
+            .store(digest, key, vector<Hashtable>{cached_hashtable()});
+
+        bool caught = false;
+        vector<Hashtable> tables;
+        try {
+            OfflineCache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_wrong_sealing_b.key")
+                .load(digest, key, tables);
+        } catch (std::runtime_error err) {
+            caught = true;
+        }
+
+        if (!caught) {
+            throw UnitTestFail("cache loaded with a different sealing key");
+        }
+    }
+
+    void test_cache_tampered_tables() {
+        auto dataset = generate_dataset(32);
+        auto digest = OfflineCache::digest(dataset, PSIParams(16, 1));
+        std::string filename = CACHE_DIRECTORY "/" CACHE_FILENAME;
+
+        Number key;
+        Point::MakeRandomNonzeroScalar(key);
+        OfflineCache cache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_tampered_tables.key");
+        cache.store(digest, key, vector<Hashtable>{cached_hashtable()});
+
+        // flip a bit of the last bucket's occupancy
+        std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(-1, std::ios::end);
+        char last = file.get();
+        file.seekp(-1, std::ios::end);
+        file.put(last ^ 1);
+        file.close();
+
+        bool caught = false;
+        vector<Hashtable> tables;
+        try {
+            cache.load(digest, key, tables);
+        } catch (std::runtime_error err) {
+            caught = true;
+        }
+        if (!caught) {
+            throw UnitTestFail("cache loaded tables that were changed on disk");
+        }
+
+        // a table count the file can't hold is never allocated for
+        u64 count = u64(1) << 40;
+        file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(2 * sizeof(u64) + sizeof(cache_digest) + sizeof(block) + sizeof(Number) + sizeof(cache_digest));
+        file.write((const char*) &count, sizeof(u64));
+        file.close();
+        if (cache.load(digest, key, tables)) {
+            throw UnitTestFail("cache loaded with a table count larger than the file");
+        }
+    }
+
+    void test_cache_epoch() {
+        std::remove(CACHE_DIRECTORY "/" CACHE_EPOCH_FILENAME);
+        OfflineCache cache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_epoch.key");
+
+        Number first, again, rotated, restarted;
+        u64 id = cache.epoch(first);
+        if (id == 0 || cache.epoch(again) != id) {
+            throw UnitTestFail("key epoch id changed within an epoch");
+        }
+        if (again != first) {
+            throw UnitTestFail("secret key changed within an epoch");
+        }
+        u64 rotated_id = cache.epoch(rotated, true);
+        if (rotated_id == 0 || rotated_id == id || rotated == first) {
+            throw UnitTestFail("rotating didn't start a new epoch under a new key");
+        }
+
+        // losing the epoch file mustn't bring back an id clients have seen
+        std::remove(CACHE_DIRECTORY "/" CACHE_EPOCH_FILENAME);
+        u64 restarted_id = cache.epoch(restarted);
+        if (restarted_id == id || restarted_id == rotated_id) {
+            throw UnitTestFail("a new epoch file reused an earlier epoch id");
+        }
+
+        bool caught = false;
+        try {
+            OfflineCache(CACHE_DIRECTORY, CACHE_DIRECTORY "/test_epoch_other.key").epoch(again);
+        } catch (std::runtime_error err) {
+            caught = true;
+        }
+        if (!caught) {
+            throw UnitTestFail("epoch key loaded with a different sealing key");
+        }
+    }
+
+    void test_result_cache() {
+        std::string filename = CACHE_DIRECTORY "/test_result_cache";
+        std::remove(filename.c_str());
+
+        ResultCache cache(filename, HASH_3_SIZE);
+        if (cache.epoch() != 0 || cache.size() != 0) {
+            throw UnitTestFail("result cache didn't start out empty");
+        }
+        cache.rotate(3);
+        for (INPUT_TYPE i = 0; i < 8; i++) {
+            cache.insert(i, hash_type(HASH_3_SIZE, u8(i)));
+        }
+        cache.to_file();
+
+        ResultCache loaded(filename, HASH_3_SIZE);
+        if (loaded.epoch() != 3 || loaded.size() != 8) {
+            throw UnitTestFail("result cache changed through the file");
+        }
+        for (INPUT_TYPE i = 0; i < 8; i++) {
+            auto result = loaded.find(i);
+            if (!result || *result != hash_type(HASH_3_SIZE, u8(i))) {
+                throw UnitTestFail("cached output changed through the file");
+            }
+        }
+        if (loaded.find(8)) {
+            throw UnitTestFail("found an output that was never cached");
+        }
+
+        // outputs under another key or of another size are no use
+        loaded.rotate(4);
+        if (loaded.size() != 0) {
+            throw UnitTestFail("kept outputs from the previous epoch");
+        }
+        if (ResultCache(filename, HASH_3_SIZE + 6).size() != 0) {
+            throw UnitTestFail("read outputs of a different size");
+        }
+
+        // a count the file can't hold is caught before anything is reserved
+        {
+            std::fstream file(filename, std::ios::in | std::ios::out | std::ios::binary);
+            u64 count = u64(1) << 60;
+            file.seekp(3 * sizeof(u64));
+            file.write((const char*) &count, sizeof(u64));
+        }
+        bool caught = false;
+        try {
+            ResultCache(filename, HASH_3_SIZE);
+        } catch (std::runtime_error err) {
+            caught = true;
+        }
+        if (!caught) {
+            throw UnitTestFail("read a result cache claiming more outputs than it holds");
+        }
+    }
+}
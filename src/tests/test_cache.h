@@ -0,0 +1,10 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_cache_store_load();
+    void test_cache_digest_mismatch();
+    void test_cache_wrong_sealing_key();
+    void test_cache_tampered_tables();
+    void test_cache_epoch();
+    void test_result_cache();
+}
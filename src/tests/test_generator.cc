@@ -0,0 +1,87 @@
+#include "test_generator.h"
+
+#include <algorithm>
+#include <set>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../generator.h"
+#include "../utils.h"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    void test_permutation_bijective() {
+        for (u64 size : { 1, 7, 1000, 4096 }) {
+            Permutation permutation(size, 42);
+            vector<bool> seen(size, false);
+            for (auto i = 0; i < size; i++) {
+                u64 value = permutation(i);
+                if (value >= size || seen[value]) {
+                    throw UnitTestFail("permutation of " + std::to_string(size) + " is not a bijection");
+                }
+                seen[value] = true;
+            }
+        }
+    }
+
+    void test_generator_exact_overlap() {
+        for (bool shuffle : { false, true }) {
+            DatasetGenerator generator(5000, 300, 123, 7, shuffle);
+
+            std::set<INPUT_TYPE> server, client;
+            for (auto i = 0; i < 5000; i++) { server.insert(generator.server(i)); }
+            for (auto i = 0; i < 300; i++) { client.insert(generator.client(i)); }
+            if (server.size() != 5000 || client.size() != 300) {
+                throw UnitTestFail("generated datasets have duplicate elements");
+            }
+
+            vector<INPUT_TYPE> overlap;
+            std::set_intersection(
+                server.begin(), server.end(), client.begin(), client.end(),
+                std::back_inserter(overlap)
+            );
+            if (overlap.size() != 123) {
+                throw UnitTestFail("expected an overlap of 123 but found " + std::to_string(overlap.size()));
+            }
+        }
+    }
+
+    void test_generator_reproducible() {
+        DatasetGenerator first(1000, 100, 10, 99), second(1000, 100, 10, 99), other(1000, 100, 10, 100);
+        bool differs = false;
+        for (auto i = 0; i < 100; i++) {
+            if (first.client(i) != second.client(i) || first.server(i) != second.server(i)) {
+                throw UnitTestFail("same seed gave different datasets");
+            }
+            differs |= first.server(i) != other.server(i);
+        }
+        if (!differs) {
+            throw UnitTestFail("different seeds gave the same datasets");
+        }
+    }
+
+    void test_generator_write() {
+        // spans a few chunks so every thread writes something
+        u64 server_size = 3 * GENERATOR_CHUNK_SIZE + 5;
+        DatasetGenerator generator(server_size, 1000, 500, 3);
+        generator.write("/tmp/test_generator_server.db", "/tmp/test_generator_client.db", 3);
+
+        auto server = read_dataset<INPUT_TYPE>("/tmp/test_generator_server.db");
+        auto client = read_dataset<INPUT_TYPE>("/tmp/test_generator_client.db");
+        if (server.size() != server_size || client.size() != 1000) {
+            throw UnitTestFail("written datasets have the wrong sizes");
+        }
+        for (auto i = 0; i < server.size(); i++) {
+            if (server[i] != generator.server(i)) {
+                throw UnitTestFail("server element " + std::to_string(i) + " written incorrectly");
+            }
+        }
+        for (auto i = 0; i < client.size(); i++) {
+            if (client[i] != generator.client(i)) {
+                throw UnitTestFail("client element " + std::to_string(i) + " written incorrectly");
+            }
+        }
+    }
+}
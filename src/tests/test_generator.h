@@ -0,0 +1,8 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_permutation_bijective();
+    void test_generator_exact_overlap();
+    void test_generator_reproducible();
+    void test_generator_write();
+}
@@ -1,6 +1,7 @@
 #include "test_hashtable.h"
 
 #include <algorithm>
+#include <fstream>
 #include <random>
 #include <stdio.h>
 
@@ -28,6 +29,17 @@ namespace unbalanced_psi {
         return false;
     }
 
+    /**
+     * hashed group elements for the inputs 0 .. <count> - 1
+     */
+    static vector<vector<u8>> hashed_entries(INPUT_TYPE count, u64 entry_size = HASH_SIZE) {
+        vector<vector<u8>> entries(count, vector<u8>(entry_size));
+        for (INPUT_TYPE i = 0; i < count; i++) {
+            hash_group_element(hash_to_group_element(i), entry_size, entries[i].data());
+        }
+        return entries;
+    }
+
     void test_hash_repeat() {
 
         u64 TABLE_SIZE(1024);
@@ -60,6 +72,17 @@ namespace unbalanced_psi {
         }
     }
 
+    void test_hash_short_entry() {
+        u64 TABLE_SIZE(1024);
+
+        // shorter entries hash as if zero extended to eight bytes
+        vector<u8> entry = { 1, 2, 3, 4, 5, 6 };
+        vector<u8> extended = { 1, 2, 3, 4, 5, 6, 0, 0 };
+        if (Hashtable::hash(entry, TABLE_SIZE) != Hashtable::hash(extended, TABLE_SIZE)) {
+            throw UnitTestFail("6 byte entry hashed differently than its extension");
+        }
+    }
+
     void test_hashtable_insert_one() {
         INPUT_TYPE element = 42;
         u64 TABLE_SIZE = 1024;
@@ -169,4 +192,214 @@ namespace unbalanced_psi {
             }
         }
     }
+
+    void test_hashtable_merge() {
+        u64 TABLE_SIZE = 16;
+        INPUT_TYPE ELEMENTS = 64;
+
+        Hashtable whole(TABLE_SIZE);
+        Hashtable first(TABLE_SIZE);
+        Hashtable second(TABLE_SIZE);
+
+        for (INPUT_TYPE i = 0; i < ELEMENTS; i++) {
+            Point encrypted = hash_to_group_element(i);
+            vector<u8> hashed(HASH_SIZE);
+            hash_group_element(encrypted, hashed.size(), hashed.data());
+            whole.insert(hashed);
+            (i % 2 == 0 ? first : second).insert(hashed);
+        }
+
+        first.merge(second);
+
+        if (first.size != whole.size || first.width != whole.width) {
+            throw UnitTestFail("merged hashtable size or width differs from a single hashtable");
+        }
+
+        // entries can be in a different order within a bucket
+        for (int i = 0; i < whole.buckets(); i++) {
+            vector<vector<u8>> expected, actual;
+            for (int j = 0; j < whole.table[i].size(); j += HASH_SIZE) {
+                expected.emplace_back(whole.table[i].begin() + j, whole.table[i].begin() + j + HASH_SIZE);
+                actual.emplace_back(first.table[i].begin() + j, first.table[i].begin() + j + HASH_SIZE);
+            }
+            std::sort(expected.begin(), expected.end());
+            std::sort(actual.begin(), actual.end());
+            if (first.table[i].size() != whole.table[i].size() || expected != actual) {
+                throw UnitTestFail("merged bucket " + std::to_string(i) + " has the wrong entries");
+            }
+        }
+    }
+
+    void test_hashtable_compact_round_trip() {
+        INPUT_TYPE SAMPLES = 256;
+
+        if (Hashtable::compact_size(10, u64(1) << 16) != 8) {
+            throw UnitTestFail("10 byte entries in 2^16 buckets should compact to 8 bytes");
+        }
+        if (Hashtable::compact_size(6, u64(1) << 20) != 4) {
+            throw UnitTestFail("6 byte entries in 2^20 buckets should compact to 4 bytes");
+        }
+
+        for (u64 entry_size : { 6, 8, 10, 16 }) {
+            for (u64 table_size : { u64(1), u64(1000), u64(1) << 16, u64(3) << 20 }) {
+                for (auto& hashed : hashed_entries(SAMPLES, entry_size)) {
+                    auto compacted = Hashtable::compact_entry(hashed, table_size);
+                    if (compacted.size() != Hashtable::compact_size(entry_size, table_size)) {
+                        throw UnitTestFail("compacted entry has the wrong size");
+                    }
+
+                    u64 bucket = Hashtable::hash(hashed, table_size);
+                    auto expanded = Hashtable::expand_entry(compacted.data(), bucket, entry_size, table_size);
+                    if (expanded != hashed) {
+                        throw UnitTestFail(
+                            "compacted entry didn't expand back to itself:\n"
+                            + to_hex(hashed.data(), hashed.size()) + " vs.\n"
+                            + to_hex(expanded.data(), expanded.size())
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    void test_hashtable_compact_insert() {
+        u64 TABLE_SIZE = 1 << 16;
+        INPUT_TYPE ELEMENTS = 64;
+        u64 compact_size = Hashtable::compact_size(HASH_SIZE, TABLE_SIZE);
+
+        Hashtable hashtable(TABLE_SIZE, true);
+        for (auto& hashed : hashed_entries(ELEMENTS)) {
+            hashtable.insert(hashed);
+
+            auto& bucket = hashtable.table[Hashtable::hash(hashed, TABLE_SIZE)];
+            auto compacted = Hashtable::compact_entry(hashed, TABLE_SIZE);
+            if (!std::equal(compacted.begin(), compacted.end(), bucket.begin())) {
+                throw UnitTestFail("compact hashtable didn't store the compacted entry");
+            }
+        }
+
+        hashtable.pad();
+        for (auto& bucket : hashtable.table) {
+            if (bucket.size() != hashtable.width || bucket.size() % compact_size != 0) {
+                throw UnitTestFail("padded compact bucket isn't a whole number of entries");
+            }
+        }
+    }
+
+    void test_hashtable_remove() {
+        u64 TABLE_SIZE = 16;
+        INPUT_TYPE ELEMENTS = 64;
+
+        Hashtable hashtable(TABLE_SIZE, true);
+        auto entries = hashed_entries(ELEMENTS);
+        for (auto& hashed : entries) { hashtable.insert(hashed); }
+        hashtable.pad();
+        u64 width = hashtable.width;
+
+        for (INPUT_TYPE i = 0; i < ELEMENTS; i += 2) {
+            if (!hashtable.remove(entries[i])) {
+                throw UnitTestFail("couldn't remove an entry of the table");
+            }
+        }
+        if (hashtable.remove(entries[0])) {
+            throw UnitTestFail("removed an entry twice");
+        }
+
+        for (INPUT_TYPE i = 0; i < ELEMENTS; i++) {
+            if (hashtable.contains(entries[i]) != (i % 2 == 1)) {
+                throw UnitTestFail("table holds the wrong entries after removal");
+            }
+        }
+        for (auto& bucket : hashtable.table) {
+            if (bucket.size() != width) {
+                throw UnitTestFail("removal changed the size of a padded bucket");
+            }
+        }
+        if (hashtable.size != ELEMENTS / 2) {
+            throw UnitTestFail("removal didn't update the number of entries");
+        }
+    }
+
+    void test_hashtable_insert_padded() {
+        u64 TABLE_SIZE = 16;
+        INPUT_TYPE ELEMENTS = 64;
+
+        Hashtable hashtable(TABLE_SIZE);
+        auto entries = hashed_entries(ELEMENTS);
+        for (INPUT_TYPE i = 1; i < ELEMENTS; i++) { hashtable.insert(entries[i]); }
+        hashtable.pad();
+
+        // the bucket has room when it isn't the widest, otherwise every bucket widens
+        u64 index = Hashtable::hash(entries[0], TABLE_SIZE);
+        bool room = hashtable.occupancy[index] * HASH_SIZE < hashtable.width;
+        u64 width = hashtable.width;
+        if (hashtable.insert(entries[0]) == room) {
+            throw UnitTestFail("insert misreported whether the table widened");
+        }
+        if (hashtable.width != (room ? width : width + HASH_SIZE)) {
+            throw UnitTestFail("insert into a padded table changed its width wrongly");
+        }
+        for (auto& bucket : hashtable.table) {
+            if (bucket.size() != hashtable.width) {
+                throw UnitTestFail("padded table isn't rectangular after insert");
+            }
+        }
+        if (!hashtable.contains(entries[0]) || !std::equal(entries[0].begin(), entries[0].end(), hashtable.table[index].begin())) {
+            throw UnitTestFail("inserted entry isn't at the front of its bucket");
+        }
+    }
+
+    void test_hashtable_sparse_file() {
+        u64 TABLE_SIZE = 64;
+        INPUT_TYPE ELEMENTS = 200;
+        string SPARSE_FILE = "/tmp/test_hashtable_sparse.edb";
+        string PADDED_FILE = "/tmp/test_hashtable_padded.edb";
+
+        Hashtable hashtable(TABLE_SIZE, true);
+        for (auto& hashed : hashed_entries(ELEMENTS)) { hashtable.insert(hashed); }
+        hashtable.pad();
+
+        hashtable.to_file(SPARSE_FILE, Hashtable::compact_size(HASH_SIZE, TABLE_SIZE));
+        hashtable.to_file(PADDED_FILE);
+
+        auto loaded = Hashtable::from_file(SPARSE_FILE);
+        if (loaded.table != hashtable.table || loaded.width != hashtable.width
+                || loaded.occupancy != hashtable.occupancy || loaded.size != hashtable.size
+                || loaded.compact != hashtable.compact) {
+            throw UnitTestFail("hashtable changed through a sparse file");
+        }
+        if (read_dataset<u8>(SPARSE_FILE).size() >= read_dataset<u8>(PADDED_FILE).size()) {
+            throw UnitTestFail("sparse file is no smaller than the padded one");
+        }
+
+        // a bucket claiming more entries than its width holds
+        std::fstream file(SPARSE_FILE, std::ios::in | std::ios::out | std::ios::binary);
+        u32 length = hashtable.width;
+        file.seekp(5 * sizeof(u64));
+        file.write((const char*) &length, sizeof(u32));
+        file.close();
+        bool caught = false;
+        try {
+            Hashtable::from_file(SPARSE_FILE);
+        } catch (std::runtime_error&) {
+            caught = true;
+        }
+        if (!caught) {
+            throw UnitTestFail("read a bucket wider than the table");
+        }
+
+        // a width far beyond what any bucket needs
+        hashtable.to_file(SPARSE_FILE, Hashtable::compact_size(HASH_SIZE, TABLE_SIZE));
+        file.open(SPARSE_FILE, std::ios::in | std::ios::out | std::ios::binary);
+        u64 width = u64(1) << 40;
+        file.seekp(1 * sizeof(u64));
+        file.write((const char*) &width, sizeof(u64));
+        file.close();
+        try {
+            Hashtable::from_file(SPARSE_FILE);
+        } catch (std::runtime_error&) {
+            return;
+        }
+        throw UnitTestFail("read a table wider than its widest bucket");
+    }
 }
@@ -3,9 +3,16 @@
 namespace unbalanced_psi {
     void test_hash_repeat();
     void test_hash_range();
+    void test_hash_short_entry();
     void test_hashtable_insert_one();
     void test_hashtable_insert_many();
     void test_hashtable_pad_empty();
     void test_hashtable_pad_one();
     void test_hashtable_pad_many();
+    void test_hashtable_merge();
+    void test_hashtable_compact_round_trip();
+    void test_hashtable_compact_insert();
+    void test_hashtable_remove();
+    void test_hashtable_insert_padded();
+    void test_hashtable_sparse_file();
 }
@@ -0,0 +1,122 @@
+#include "test_metrics.h"
+
+#include <thread>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../metrics.h"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    void test_metrics_name() {
+        string name = Metrics::name("[ server ] oprf online comp");
+        if (name != "server.oprf_online_comp") {
+            throw UnitTestFail("Metrics::name() gave " + name);
+        }
+        name = Metrics::name("[  both  ] oprf comm (MB)");
+        if (name != "both.oprf_comm_mb") {
+            throw UnitTestFail("Metrics::name() gave " + name);
+        }
+    }
+
+    void test_metrics_accumulate() {
+        Metrics metrics;
+        metrics.time("phase.compute", 1.5);
+        std::thread other([&]() { metrics.time("phase.compute", 0.5); });
+        other.join();
+        metrics.count("points", 3);
+        metrics.count("points");
+        metrics.bytes("sent", 10);
+        metrics.bytes("sent", 20);
+
+        if (metrics.seconds("phase.compute") != 2.0) {
+            throw UnitTestFail("timer did not sum both threads' reports");
+        }
+        if (metrics.counter("points") != 4) {
+            throw UnitTestFail("counter did not accumulate");
+        }
+        if (metrics.gauge("sent") != 20) {
+            throw UnitTestFail("gauge did not keep the latest value");
+        }
+        if (metrics.seconds("missing") != 0 || metrics.counter("missing") != 0) {
+            throw UnitTestFail("unreported metrics should read as zero");
+        }
+
+        metrics.reset();
+        if (metrics.counter("points") != 0) {
+            throw UnitTestFail("reset() left a counter behind");
+        }
+    }
+
+    void test_metrics_json() {
+        Metrics metrics;
+        metrics.time("client.online.network", 0.25);
+        metrics.count("server.online.points", 7);
+        metrics.bytes("client.network.sent", 1024);
+
+        string json = metrics.to_json();
+        vector<string> expected = {
+            "\"timers\"", "\"client.online.network\": { \"seconds\": 0.250000, \"calls\": 1",
+            "\"counters\"", "\"server.online.points\": 7",
+            "\"bytes\"", "\"client.network.sent\": 1024"
+        };
+        for (auto& part : expected) {
+            if (json.find(part) == string::npos) {
+                throw UnitTestFail("json output missing " + part);
+            }
+        }
+    }
+
+    void test_metrics_memory_phase() {
+        u64 size = 64 << 20;
+
+        MemoryPhase memory("test.memory");
+        vector<u8> allocated(size, 1);
+        memory.stop();
+
+        // touched pages are resident, so the peak must have grown by about as much
+        u64 delta = Metrics::global().gauge("test.memory.peak_delta");
+        if (delta < size / 2) {
+            throw UnitTestFail("peak rss only grew by " + std::to_string(delta) + " bytes");
+        }
+        if (Metrics::global().gauge("test.memory.peak_rss") < current_rss()) {
+            throw UnitTestFail("peak rss below current rss");
+        }
+    }
+
+    void test_metrics_nested_memory_phases() {
+        u64 size = 64 << 20;
+
+        MemoryPhase outer("test.outer_memory");
+        {
+            vector<u8> allocated(size, 1);
+        }
+
+        // a phase starting later mustn't wipe the outer phase's peak
+        MemoryPhase inner("test.inner_memory");
+        inner.stop();
+        outer.stop();
+
+        u64 delta = Metrics::global().gauge("test.outer_memory.peak_delta");
+        if (delta < size / 2) {
+            throw UnitTestFail("outer peak rss only grew by " + std::to_string(delta) + " bytes");
+        }
+    }
+
+    void test_metrics_hardware_counters() {
+        PerfCounters counters;
+
+        // nothing to check where the kernel doesn't allow counting
+        if (!counters.available()) { return; }
+
+        volatile u64 sum = 0;
+        for (auto i = 0; i < 1000000; i++) { sum += i; }
+
+        auto counts = counters.read();
+        if (counts[1] < 1000000) {
+            throw UnitTestFail("counted " + std::to_string(counts[1]) + " instructions for 1M iterations");
+        }
+    }
+}
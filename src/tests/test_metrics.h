@@ -0,0 +1,10 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_metrics_name();
+    void test_metrics_accumulate();
+    void test_metrics_json();
+    void test_metrics_memory_phase();
+    void test_metrics_nested_memory_phases();
+    void test_metrics_hardware_counters();
+}
@@ -0,0 +1,281 @@
+#include "test_online.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include <coproto/Socket/LocalAsyncSock.h>
+#include <cryptoTools/Common/TestCollection.h>
+#include <cryptoTools/Network/Session.h>
+
+#include "../client.h"
+#include "../coordinator.h"
+#include "../server.h"
+
+#define ONLINE_ADDRESS "127.0.0.1:1215"
+#define CACHE_DIRECTORY "/tmp"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    // the client holds the first <overlap> items of the server's dataset
+    //  followed by items the server doesn't have
+    vector<INPUT_TYPE> online_client_dataset(const vector<INPUT_TYPE>& server, u64 size, u64 overlap) {
+        vector<INPUT_TYPE> dataset(server.begin(), server.begin() + overlap);
+        for (INPUT_TYPE i = 0; dataset.size() < size; i++) {
+            INPUT_TYPE item = ~i;
+            if (std::find(server.begin(), server.end(), item) == server.end()) { dataset.push_back(item); }
+        }
+        return dataset;
+    }
+
+    void check_intersection(Hashtable& hashtable, const vector<hash_type>& results, u64 overlap) {
+        for (auto i = 0; i < results.size(); i++) {
+            if (hashtable.contains(results[i]) != (i < overlap)) {
+                throw UnitTestFail("online exchange gave the wrong output for item " + std::to_string(i));
+            }
+        }
+    }
+
+    void test_online_intersection() {
+        PSIParams params(64, 1);
+        params.compact = false;
+        auto server_dataset = generate_dataset(256);
+        auto client_dataset = online_client_dataset(server_dataset, 16, 5);
+
+        Server server(server_dataset, params);
+        auto hashtables = server.offline();
+        Client client(client_dataset, params);
+        client.offline();
+
+        IOService ios;
+        Session server_session(ios, ONLINE_ADDRESS, SessionMode::Server, "online-intersection");
+        Session client_session(ios, ONLINE_ADDRESS, SessionMode::Client, "online-intersection");
+        vector<Channel> server_channels, client_channels;
+        for (auto i = 0; i < 3; i++) {
+            server_channels.push_back(server_session.addChannel());
+            client_channels.push_back(client_session.addChannel());
+        }
+
+        auto serving = std::async(std::launch::async, [&]() { server.online(server_channels); });
+        auto [ results, queries ] = client.online(client_channels);
+        serving.get();
+
+        if (results.size() != client_dataset.size()) {
+            throw UnitTestFail("client got a different number of outputs than it has items");
+        }
+        check_intersection(hashtables[0], results, 5);
+    }
+
+    void test_online_sharded() {
+        PSIParams params(16, 3, 64, 1);
+        params.compact = false;
+        auto server_dataset = generate_dataset(256);
+        u64 shard_n = 3;
+
+        IOService ios;
+        vector<Session> coordinator_sessions, shard_sessions;
+        vector<Channel> shard_channels;
+        vector<future<vector<Hashtable>>> shards;
+        for (auto i = 0; i < shard_n; i++) {
+            string name = "online-sharded-" + std::to_string(i);
+            coordinator_sessions.emplace_back(ios, ONLINE_ADDRESS, SessionMode::Server, name);
+            shard_sessions.emplace_back(ios, ONLINE_ADDRESS, SessionMode::Client, name);
+            shard_channels.push_back(coordinator_sessions.back().addChannel());
+
+            Channel channel = shard_sessions.back().addChannel();
+            auto dataset = Coordinator::slice(server_dataset, i, shard_n);
+            shards.push_back(std::async(std::launch::async, [&params, dataset, channel, i, shard_n]() {
+                Shard shard(dataset, params, i, shard_n, channel);
+                auto hashtables = shard.offline();
+                shard.online();
+                return hashtables;
+            }));
+        }
+
+        Coordinator coordinator(shard_channels, params);
+        coordinator.offline();
+
+        // fewer points than shards leaves one of them idle
+        auto client_dataset = online_client_dataset(server_dataset, 2, 1);
+        Client client(client_dataset, params);
+        client.offline();
+
+        Session server_session(ios, ONLINE_ADDRESS, SessionMode::Server, "online-sharded");
+        Session client_session(ios, ONLINE_ADDRESS, SessionMode::Client, "online-sharded");
+        vector<Channel> server_channels{server_session.addChannel()};
+        vector<Channel> client_channels{client_session.addChannel()};
+
+        auto serving = std::async(std::launch::async, [&]() { coordinator.online(server_channels); });
+        auto [ results, queries ] = client.online(client_channels);
+        serving.get();
+
+        // table t is held by shard t % shards, as its (t / shards)th table
+        vector<vector<Hashtable>> held;
+        for (auto& shard : shards) { held.push_back(shard.get()); }
+        u64 entries = 0;
+        for (auto i = 0; i < shard_n; i++) {
+            if (held[i].size() != Shard::tables(i, shard_n, params).size()) {
+                throw UnitTestFail("shard " + std::to_string(i) + " holds the wrong number of tables");
+            }
+            for (auto& hashtable : held[i]) { entries += hashtable.size; }
+        }
+        if (entries < server_dataset.size() || entries > params.cuckoo_hashes * server_dataset.size()) {
+            throw UnitTestFail("shards hold " + std::to_string(entries) + " entries for "
+                + std::to_string(server_dataset.size()) + " elements");
+        }
+
+        // the client's item in each cuckoo bucket is found in that bucket's table
+        //  exactly when it's in the intersection
+        u64 found = 0;
+        for (auto t = 0; t < results.size(); t++) {
+            if (queries[t] == std::numeric_limits<u64>::max()) { continue; }
+            if (held[t % shard_n][t / shard_n].contains(results[t])) { found++; }
+        }
+        if (found != 1) {
+            throw UnitTestFail("found " + std::to_string(found) + " of 1 items through the shards' tables");
+        }
+    }
+
+    void test_shard_tables() {
+        PSIParams params(10, 3, 64, 1);
+        vector<u64> held(params.cuckoo_size, 0);
+        for (auto i = 0; i < 4; i++) {
+            for (auto table : Shard::tables(i, 4, params)) {
+                if (table % 4 != i) { throw UnitTestFail("shard holds another shard's table"); }
+                held[table]++;
+            }
+        }
+        for (auto count : held) {
+            if (count != 1) { throw UnitTestFail("table isn't held by exactly one shard"); }
+        }
+    }
+
+    void test_shard_pack_outputs() {
+        u64 entry_size = HASH_3_SIZE;
+        vector<hash_type> outputs;
+        for (auto i = 0; i < 5; i++) { outputs.push_back(hash_type(entry_size, u8(i + 1))); }
+
+        auto packed = pack_outputs(outputs);
+        if (unpack_outputs(packed, entry_size) != outputs) {
+            throw UnitTestFail("outputs changed through packing");
+        }
+        auto empty = pack_outputs({});
+        if (empty.empty() || !unpack_outputs(empty, entry_size).empty()) {
+            throw UnitTestFail("no outputs didn't pack to just their count");
+        }
+
+        // a count that disagrees with the bytes sent, or a partial output
+        vector<vector<u8>> malformed{ vector<u8>(packed.begin(), packed.end() - entry_size), packed, vector<u8>(4) };
+        malformed[1].push_back(0);
+        for (auto& bad : malformed) {
+            bool caught = false;
+            try {
+                unpack_outputs(bad, entry_size);
+            } catch (std::runtime_error&) {
+                caught = true;
+            }
+            if (!caught) { throw UnitTestFail("unpacked malformed outputs"); }
+        }
+        u64 huge = u64(1) << 61;
+        std::memcpy(empty.data(), &huge, sizeof(u64));
+        bool caught = false;
+        try {
+            unpack_outputs(empty, entry_size);
+        } catch (std::runtime_error&) {
+            caught = true;
+        }
+        if (!caught) { throw UnitTestFail("unpacked a count with no outputs behind it"); }
+    }
+
+    /**
+     * run the client twice against a server in the same key epoch, the
+     *  second time with every item's output in the client's cache
+     *
+     * @params <exchange> runs one online exchange, returning the client's
+     *                    outputs and the bytes the server received
+     */
+    template<class Exchange>
+    void run_cached(string name, Exchange exchange) {
+        PSIParams params(64, 1);
+        params.compact = false;
+        auto server_dataset = generate_dataset(256);
+        auto client_dataset = online_client_dataset(server_dataset, 8, 3);
+
+        std::remove(CACHE_DIRECTORY "/" CACHE_EPOCH_FILENAME);
+        string results_file = CACHE_DIRECTORY "/" + name + ".results";
+        std::remove(results_file.c_str());
+
+        OfflineCache offline_cache(CACHE_DIRECTORY, CACHE_DIRECTORY "/" + name + ".key");
+        ResultCache result_cache(results_file, params.entry_size);
+
+        Server server(server_dataset, params);
+        server.use_epoch(offline_cache);
+        auto hashtables = server.offline();
+
+        vector<hash_type> first;
+        for (auto run = 0; run < 2; run++) {
+            Client client(client_dataset, params);
+            client.reuse(result_cache);
+            client.offline();
+
+            auto [ results, received ] = exchange(server, client, name + "-" + std::to_string(run));
+            check_intersection(hashtables[0], results, 3);
+            if (run == 0) {
+                first = results;
+                if (result_cache.size() != client_dataset.size()) {
+                    throw UnitTestFail("client didn't cache the outputs of its first run");
+                }
+            } else {
+                if (results != first) {
+                    throw UnitTestFail("cached outputs differ from the ones computed");
+                }
+                if (received != sizeof(u64)) {
+                    throw UnitTestFail("server received " + std::to_string(received)
+                        + " bytes from a client with every item cached");
+                }
+            }
+        }
+        std::remove(CACHE_DIRECTORY "/" CACHE_EPOCH_FILENAME);
+    }
+
+    void test_online_all_cached() {
+        run_cached("test_online_all_cached", [](Server& server, Client& client, string name) {
+            IOService ios;
+            Session server_session(ios, ONLINE_ADDRESS, SessionMode::Server, name);
+            Session client_session(ios, ONLINE_ADDRESS, SessionMode::Client, name);
+            vector<Channel> server_channels{server_session.addChannel(), server_session.addChannel()};
+            vector<Channel> client_channels{client_session.addChannel(), client_session.addChannel()};
+
+            auto serving = std::async(std::launch::async, [&]() { server.online(server_channels); });
+            auto [ results, queries ] = client.online(client_channels);
+            serving.get();
+
+            u64 received = 0;
+            for (auto& channel : server_channels) { received += channel.getTotalDataRecv(); }
+            return std::make_tuple(results, received);
+        });
+    }
+
+    void test_online_async_all_cached() {
+        run_cached("test_online_async_all_cached", [](Server& server, Client& client, string name) {
+            macoro::thread_pool pool;
+            auto work = pool.make_work();
+            pool.create_thread();
+
+            auto sockets = coproto::LocalAsyncSocket::makePair();
+            auto serving = std::async(std::launch::async, [&]() {
+                coproto::sync_wait(server.online(sockets[0], pool));
+            });
+            auto [ results, queries ] = coproto::sync_wait(client.online(sockets[1]));
+            serving.get();
+
+            work.reset();
+            pool.join();
+            return std::make_tuple(results, u64(sockets[0].bytesReceived()));
+        });
+    }
+}
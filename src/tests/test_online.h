@@ -0,0 +1,10 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_online_intersection();
+    void test_online_sharded();
+    void test_shard_tables();
+    void test_shard_pack_outputs();
+    void test_online_all_cached();
+    void test_online_async_all_cached();
+}
@@ -0,0 +1,120 @@
+#include "test_resolver.h"
+
+#include <cstdio>
+#include <limits>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../resolver.h"
+#include "../utils.h"
+
+#define RESOLVER_TEST_FILE "/tmp/resolver.index"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    /**
+     * bucket of <slots> entries counting up from <first>
+     */
+    vector<u8> counting_bucket(u64 slots, u64 entry_size, u8 first) {
+        vector<u8> bucket(slots * entry_size);
+        for (auto i = 0; i < slots; i++) {
+            std::fill(bucket.begin() + i * entry_size, bucket.begin() + (i + 1) * entry_size, u8(first + i));
+        }
+        return bucket;
+    }
+
+    void test_resolver_contains() {
+        u64 SLOTS = 37;
+
+        for (u64 entry_size : { 4, 6, 8, 10, 16, 24 }) {
+            auto bucket = counting_bucket(SLOTS, entry_size, 1);
+
+            // every slot, including ones only the scalar tail reaches
+            for (auto i = 0; i < SLOTS; i++) {
+                vector<u8> expected(entry_size, u8(1 + i));
+                if (!Resolver::contains(bucket.data(), bucket.size(), expected.data(), entry_size)) {
+                    throw UnitTestFail(
+                        "missed slot " + std::to_string(i) + " of "
+                        + std::to_string(entry_size) + " byte entries"
+                    );
+                }
+            }
+
+            // straddling two slots isn't a match
+            vector<u8> straddling(entry_size, 1);
+            std::fill(straddling.begin() + entry_size / 2, straddling.end(), 2);
+            if (Resolver::contains(bucket.data(), bucket.size(), straddling.data(), entry_size)) {
+                throw UnitTestFail("matched bytes across two slots");
+            }
+
+            vector<u8> missing(entry_size, u8(1 + SLOTS));
+            if (Resolver::contains(bucket.data(), bucket.size(), missing.data(), entry_size)) {
+                throw UnitTestFail("matched an entry that isn't in the bucket");
+            }
+        }
+    }
+
+    void test_resolver_resolve() {
+        u64 ENTRY_SIZE = 8;
+        vector<INPUT_TYPE> items = { 100, 200, 300 };
+        vector<hash_type> outputs = {
+            hash_type(ENTRY_SIZE, 1), hash_type(ENTRY_SIZE, 2), hash_type(ENTRY_SIZE, 3)
+        };
+        vector<u64> queries = { 5, 6, 7 };
+        Resolver resolver(outputs, queries, items);
+
+        // first and third are in their buckets, then a blank query
+        vector<hash_type> expected = { outputs[0], outputs[1], outputs[2], hash_type(ENTRY_SIZE, 0) };
+        queries.push_back(std::numeric_limits<u64>::max());
+        vector<vector<u8>> buckets = {
+            counting_bucket(4, ENTRY_SIZE, 0),
+            counting_bucket(4, ENTRY_SIZE, 4),
+            counting_bucket(4, ENTRY_SIZE, 3),
+            vector<u8>(4 * ENTRY_SIZE, 0)
+        };
+
+        auto intersection = resolver.resolve(expected, queries, buckets);
+        if (intersection != vector<INPUT_TYPE>{ 100, 300 }) {
+            throw UnitTestFail("resolved " + std::to_string(intersection.size()) + " items instead of 100, 300");
+        }
+    }
+
+    void test_resolver_same_compacted() {
+        u64 ENTRY_SIZE = 8;
+
+        // compacted outputs only differ by the bucket they're in
+        vector<INPUT_TYPE> items = { 100, 200 };
+        vector<hash_type> outputs = { hash_type(ENTRY_SIZE, 1), hash_type(ENTRY_SIZE, 1) };
+        vector<u64> queries = { 3, 9 };
+        Resolver resolver(outputs, queries, items);
+
+        vector<vector<u8>> buckets = { counting_bucket(2, ENTRY_SIZE, 0), counting_bucket(2, ENTRY_SIZE, 1) };
+        auto intersection = resolver.resolve(outputs, queries, buckets);
+        if (intersection != vector<INPUT_TYPE>{ 100, 200 }) {
+            throw UnitTestFail("resolved " + std::to_string(intersection.size()) + " items instead of 100, 200");
+        }
+        if (resolver.resolve(outputs[0], 4, buckets[0])) {
+            throw UnitTestFail("resolved an output recovered from another bucket");
+        }
+    }
+
+    void test_resolver_file() {
+        u64 ENTRY_SIZE = 10;
+        vector<INPUT_TYPE> items = { 7, 8 };
+        vector<hash_type> outputs = { hash_type(ENTRY_SIZE, 9), hash_type(ENTRY_SIZE, 10) };
+        vector<u64> queries = { 0, 1 };
+        Resolver(outputs, queries, items).to_file(RESOLVER_TEST_FILE);
+
+        Resolver loaded(RESOLVER_TEST_FILE);
+        if (loaded.entry_bytes() != ENTRY_SIZE) {
+            throw UnitTestFail("loaded index has the wrong entry size");
+        }
+        auto item = loaded.resolve(outputs[1], queries[1], counting_bucket(2, ENTRY_SIZE, 9));
+        if (!item || *item != 8) {
+            throw UnitTestFail("loaded index didn't resolve the second item");
+        }
+        std::remove(RESOLVER_TEST_FILE);
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_resolver_contains();
+    void test_resolver_resolve();
+    void test_resolver_same_compacted();
+    void test_resolver_file();
+}
@@ -0,0 +1,155 @@
+#include "test_shaper.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cryptoTools/Common/TestCollection.h>
+
+#include "../shaper.h"
+
+namespace unbalanced_psi {
+
+    using UnitTestFail = osuCrypto::UnitTestFail;
+
+    /**
+     * server which echoes everything on its first connection back
+     */
+    class EchoServer {
+        public:
+            int listener;
+            u16 port;
+            std::thread thread;
+
+            EchoServer() {
+                sockaddr_in address{};
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                listener = socket(AF_INET, SOCK_STREAM, 0);
+                bind(listener, (sockaddr*) &address, sizeof(address));
+                listen(listener, 1);
+
+                socklen_t length = sizeof(address);
+                getsockname(listener, (sockaddr*) &address, &length);
+                port = ntohs(address.sin_port);
+
+                thread = std::thread([this]() {
+                    int connection = accept(listener, nullptr, nullptr);
+                    vector<u8> buffer(4096);
+                    ssize_t n;
+                    while ((n = recv(connection, buffer.data(), buffer.size(), 0)) > 0) {
+                        send(connection, buffer.data(), n, MSG_NOSIGNAL);
+                    }
+                    close(connection);
+                });
+            }
+
+            ~EchoServer() {
+                thread.join();
+                close(listener);
+            }
+
+            string address() { return "127.0.0.1:" + std::to_string(port); }
+    };
+
+    /**
+     * send <message> through the proxy and read it back, returning the seconds taken
+     */
+    double round_trip(Shaper& shaper, const vector<u8>& message, vector<u8>& echoed) {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(shaper.port());
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int connection = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(connection, (sockaddr*) &address, sizeof(address)) != 0) {
+            throw UnitTestFail("could not connect to the shaper");
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::thread sender([&]() {
+            send(connection, message.data(), message.size(), MSG_NOSIGNAL);
+            shutdown(connection, SHUT_WR);
+        });
+
+        echoed.resize(message.size());
+        u64 read = 0;
+        while (read < echoed.size()) {
+            ssize_t n = recv(connection, echoed.data() + read, echoed.size() - read, 0);
+            if (n <= 0) { break; }
+            read += n;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        sender.join();
+        close(connection);
+        echoed.resize(read);
+        return elapsed.count();
+    }
+
+    void test_shaper_forwards() {
+        EchoServer echo;
+        Shaper shaper("127.0.0.1:0", echo.address(), LinkParams(0, 0, 0));
+
+        vector<u8> message(100000), echoed;
+        for (auto i = 0; i < message.size(); i++) { message[i] = u8(i * 31); }
+        round_trip(shaper, message, echoed);
+
+        if (echoed != message) {
+            throw UnitTestFail("shaper altered the bytes it forwarded");
+        }
+        if (shaper.bytes_sent() != message.size() || shaper.bytes_received() != message.size()) {
+            throw UnitTestFail("shaper miscounted the bytes it forwarded");
+        }
+    }
+
+    void test_shaper_latency() {
+        EchoServer echo;
+        Shaper shaper("127.0.0.1:0", echo.address(), LinkParams(0, 40, 0));
+
+        vector<u8> message(16, 1), echoed;
+        double seconds = round_trip(shaper, message, echoed);
+        if (echoed != message) {
+            throw UnitTestFail("shaper altered the bytes it forwarded");
+        }
+        if (seconds < 0.040) {
+            throw UnitTestFail("round trip took " + std::to_string(seconds) + "s with a 40ms rtt");
+        }
+    }
+
+    void test_shaper_bandwidth() {
+        EchoServer echo;
+        Shaper shaper("127.0.0.1:0", echo.address(), LinkParams(8, 0, 0));
+
+        // 100kB each way at 1MB/s
+        vector<u8> message(100000, 7), echoed;
+        double seconds = round_trip(shaper, message, echoed);
+        if (echoed != message) {
+            throw UnitTestFail("shaper altered the bytes it forwarded");
+        }
+        if (seconds < 0.1) {
+            throw UnitTestFail("transfer took " + std::to_string(seconds) + "s at 8Mbps");
+        }
+    }
+
+    void test_shaper_in_flight() {
+        EchoServer echo;
+
+        // 10MB/s with a 20ms rtt holds 200kB in flight
+        Shaper shaper("127.0.0.1:0", echo.address(), LinkParams(80, 20, 0));
+        if (shaper.in_flight_limit() != 200000) {
+            throw UnitTestFail("in flight limit isn't one bandwidth-delay product");
+        }
+        if (Shaper("127.0.0.1:0", echo.address(), LinkParams(0, 20, 0)).in_flight_limit() != 0) {
+            throw UnitTestFail("unlimited link has an in flight limit");
+        }
+
+        // several times the limit still gets through whole
+        vector<u8> message(1000000), echoed;
+        for (auto i = 0; i < message.size(); i++) { message[i] = u8(i * 17); }
+        round_trip(shaper, message, echoed);
+        if (echoed != message) {
+            throw UnitTestFail("shaper altered the bytes it held back");
+        }
+    }
+}
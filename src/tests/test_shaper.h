@@ -0,0 +1,8 @@
+#pragma once
+
+namespace unbalanced_psi {
+    void test_shaper_forwards();
+    void test_shaper_latency();
+    void test_shaper_bandwidth();
+    void test_shaper_in_flight();
+}
@@ -2,6 +2,7 @@
 
 #include <cryptoTools/Common/TestCollection.h>
 
+#include "../blake2.h"
 #include "../utils.h"
 
 namespace unbalanced_psi {
@@ -154,4 +155,113 @@ namespace unbalanced_psi {
             );
         }
     }
+
+    void test_hash_to_group_elements_batch() {
+        // more than one batch with a partial one at the end
+        u64 count = 2 * HASH_BATCH_SIZE + 17;
+        vector<INPUT_TYPE> inputs(count);
+        for (auto i = 0; i < count; i++) { inputs[i] = INPUT_TYPE(i * 7919); }
+
+        vector<Point> batched(count);
+        hash_to_group_elements(inputs.data(), count, batched.data());
+
+        for (auto i = 0; i < count; i++) {
+            std::string expected = to_hex(hash_to_group_element(inputs[i]));
+            std::string actual = to_hex(batched[i]);
+            if (expected != actual) {
+                throw UnitTestFail(
+                    "batch hashed element " + std::to_string(i) + " differently:\n"
+                    + expected + " vs.\n" + actual
+                );
+            }
+        }
+    }
+
+    void test_hash_group_elements_batch() {
+        u64 count = 2 * HASH_BATCH_SIZE + 17;
+        vector<Point> points(count);
+        for (auto i = 0; i < count; i++) { points[i] = hash_to_group_element(INPUT_TYPE(i)); }
+
+        vector<u8> batched(count * HASH_3_SIZE);
+        hash_group_elements(points.data(), count, HASH_3_SIZE, batched.data());
+
+        vector<u8> expected(HASH_3_SIZE);
+        for (auto i = 0; i < count; i++) {
+            hash_group_element(points[i], HASH_3_SIZE, expected.data());
+            if (!std::equal(expected.begin(), expected.end(), batched.begin() + i * HASH_3_SIZE)) {
+                throw UnitTestFail(
+                    "batch hashed group element " + std::to_string(i) + " differently:\n"
+                    + to_hex(expected.data(), HASH_3_SIZE) + " vs.\n"
+                    + to_hex(batched.data() + i * HASH_3_SIZE, HASH_3_SIZE)
+                );
+            }
+        }
+    }
+
+    vector<u8> from_hex(const std::string& hex) {
+        vector<u8> bytes;
+        for (auto i = 0; i + 1 < hex.size(); i += 2) {
+            bytes.push_back(u8(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        }
+        return bytes;
+    }
+
+    void test_blake2b_many() {
+        // 32 byte digests from a reference blake2b of 32 zero bytes, the
+        //  bytes 0 to 31, the bytes 1 to 4 and the bytes 0 to 127
+        vector<std::tuple<vector<u8>, std::string>> cases;
+        vector<u8> ascending(128);
+        for (auto i = 0; i < ascending.size(); i++) { ascending[i] = u8(i); }
+        cases.emplace_back(vector<u8>(32, 0), "89eb0d6a8a691dae2cd15ed0369931ce0a949ecafa5c3f93f8121833646e15c3");
+        cases.emplace_back(vector<u8>(ascending.begin(), ascending.begin() + 32),
+            "cb2f5160fc1f7e05a55ef49d340b48da2e5a78099d53393351cd579dd42503d6");
+        cases.emplace_back(vector<u8>{ 1, 2, 3, 4 }, "28517e4cdf6c90798c1a983b03727ca7743c21a3880672429ccfc5bd15ea5f72");
+        cases.emplace_back(ascending, "c3582f71ebb2be66fa5dd750f80baae97554f3b015663c8be377cfcb2488c1d1");
+
+        // enough copies to fill the simd lanes and leave some over
+        u64 count = 2 * BLAKE2B_LANES + 1;
+        for (auto& [ message, digest ] : cases) {
+            vector<u8> inputs;
+            for (auto i = 0; i < count; i++) { inputs.insert(inputs.end(), message.begin(), message.end()); }
+            vector<u8> outputs(count * 32);
+            blake2b_many(inputs.data(), message.size(), count, 32, outputs.data());
+
+            auto expected = from_hex(digest);
+            for (auto i = 0; i < count; i++) {
+                if (!std::equal(expected.begin(), expected.end(), outputs.begin() + i * 32)) {
+                    throw UnitTestFail(
+                        "wrong blake2b of a " + std::to_string(message.size()) + " byte message in lane "
+                        + std::to_string(i)
+                    );
+                }
+            }
+        }
+    }
+
+    void test_false_positive_bound() {
+        // 2^20 * 2^10 / 2^80
+        double bound = false_positive_bound(u64(1) << 20, u64(1) << 10, 10);
+        if (bound != std::ldexp(1.0, -50)) {
+            throw UnitTestFail("wrong bound for 10 byte entries: " + std::to_string(bound));
+        }
+        if (false_positive_bound(u64(1) << 40, u64(1) << 20, 6) != 1.0) {
+            throw UnitTestFail("bound should be capped at one");
+        }
+
+        // 2^60 / 2^48 is too many for 6 bytes, 2^60 / 2^64 is under 1e-1
+        if (smallest_entry_size(u64(1) << 40, u64(1) << 20, 1e-1) != 8) {
+            throw UnitTestFail("expected 8 byte entries to be the smallest under 1e-1");
+        }
+        if (smallest_entry_size(u64(1) << 40, u64(1) << 20, 1e-30) != 16) {
+            throw UnitTestFail("expected 16 byte entries to be the smallest under 1e-30");
+        }
+        for (u64 entry_size : { 6, 8, 10, 16 }) {
+            if (!supported_entry_size(entry_size)) {
+                throw UnitTestFail(std::to_string(entry_size) + " byte entries should be supported");
+            }
+        }
+        if (supported_entry_size(12)) {
+            throw UnitTestFail("12 byte entries shouldn't be supported");
+        }
+    }
 }
@@ -8,4 +8,8 @@ namespace unbalanced_psi {
     void test_hash_to_group_element_diff();
     void test_hash_group_element_same();
     void test_hash_group_element_diff();
+    void test_hash_to_group_elements_batch();
+    void test_hash_group_elements_batch();
+    void test_blake2b_many();
+    void test_false_positive_bound();
 }
@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <sstream>
+
 #include <algorithm>
 #include <cmath>
 #include <gsl/span>
@@ -9,10 +11,31 @@
 
 #include <apsi/util/utils.h>
 
+#include "blake2.h"
+#include "generator.h"
+
 using namespace std::chrono;
 
 namespace unbalanced_psi {
 
+    bool supported_entry_size(u64 entry_size) {
+        return entry_size == 6 || entry_size == 8 || entry_size == 10 || entry_size == 16;
+    }
+
+    double false_positive_bound(u64 server_size, u64 client_size, u64 entry_size) {
+        double bound = std::ldexp(double(server_size) * double(client_size), -8 * int(entry_size));
+        return std::min(bound, 1.0);
+    }
+
+    u64 smallest_entry_size(u64 server_size, u64 client_size, double rate) {
+        for (u64 entry_size : { 6, 8, 10, 16 }) {
+            if (false_positive_bound(server_size, client_size, entry_size) <= rate) {
+                return entry_size;
+            }
+        }
+        return 16;
+    }
+
     vector<INPUT_TYPE> generate_dataset(int size) {
         block seed(std::rand());
         PRNG prng(seed);
@@ -23,12 +46,13 @@ namespace unbalanced_psi {
     }
 
     tuple<vector<INPUT_TYPE>,vector<INPUT_TYPE>> generate_datasets(int server_size, int client_size, int overlap) {
-        vector<INPUT_TYPE> both   = generate_dataset(overlap);
-        vector<INPUT_TYPE> server = generate_dataset(server_size - overlap);
-        vector<INPUT_TYPE> client = generate_dataset(client_size - overlap);
+        u64 seed = (u64(std::random_device{}()) << 32) | std::random_device{}();
+        DatasetGenerator generator(server_size, client_size, overlap, seed);
 
-        server.insert(server.end(), both.begin(), both.end());
-        client.insert(client.end(), both.begin(), both.end());
+        vector<INPUT_TYPE> server(server_size);
+        vector<INPUT_TYPE> client(client_size);
+        for (auto i = 0; i < server_size; i++) { server[i] = generator.server(i); }
+        for (auto i = 0; i < client_size; i++) { client[i] = generator.client(i); }
 
         tuple<vector<INPUT_TYPE>,vector<INPUT_TYPE>> datasets(server, client);
         return datasets;
@@ -57,6 +81,36 @@ namespace unbalanced_psi {
         apsi::util::copy_bytes(item_hash_and_label_key.data(), length, dest);
     }
 
+    void hash_to_group_elements(const INPUT_TYPE* inputs, u64 count, Point* dest) {
+        for (auto i = 0; i < count; i++) {
+            dest[i] = Point(gsl::span<const u8>{
+                reinterpret_cast<const u8*>(inputs + i),
+                sizeof(INPUT_TYPE)
+            });
+        }
+    }
+
+    void hash_group_elements(const Point* elements, u64 count, int length, u8* dest) {
+        // extract_hash() is blake2b of the point's y coordinate, which is its
+        //  saved form without the sign of x in the top bit, so the points are
+        //  saved a block at a time and their hashes computed in simd lanes
+        vector<u8> encoded(std::min<u64>(count, HASH_BATCH_SIZE) * Point::save_size);
+        vector<u8> digests(std::min<u64>(count, HASH_BATCH_SIZE) * Point::hash_size);
+        for (u64 begin = 0; begin < count; begin += HASH_BATCH_SIZE) {
+            u64 size = std::min<u64>(HASH_BATCH_SIZE, count - begin);
+            for (auto i = 0; i < size; i++) {
+                u8* point = encoded.data() + i * Point::save_size;
+                elements[begin + i].save(Point::point_save_span_type{point, Point::save_size});
+                point[Point::save_size - 1] &= 0x7F;
+            }
+            blake2b_many(encoded.data(), Point::save_size, size, Point::hash_size, digests.data());
+
+            for (auto i = 0; i < size; i++) {
+                apsi::util::copy_bytes(digests.data() + i * Point::hash_size, length, dest + (begin + i) * length);
+            }
+        }
+    }
+
     std::string to_hex(const Point& point) {
         vector<u8> bytes(Point::save_size);
         point.save(Point::point_save_span_type{bytes.data(), bytes.size()});
@@ -77,14 +131,22 @@ namespace unbalanced_psi {
     }
 
     Timer::Timer(std::string msg, std::string color) : message(msg), color(color) {
+        if (Metrics::global().counting_hardware()) {
+            counters = std::make_unique<PerfCounters>();
+        }
         start = high_resolution_clock::now();
     }
 
     void Timer::stop() {
         auto stop = high_resolution_clock::now();
         duration<float> elapsed = stop - start;
-        std::cout << std::fixed << std::setprecision(3);
-        std::cout << color << message << " (s)\t: ";
-        std::cout << elapsed.count() << RESET << std::endl;
+
+        // in one write so timers stopped on other threads don't interleave
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3);
+        line << color << message << " (s)\t: " << elapsed.count() << RESET << "\n";
+        std::cout << line.str() << std::flush;
+        Metrics::global().time(Metrics::name(message), elapsed.count());
+        if (counters) { counters->report(Metrics::name(message)); }
     }
 }
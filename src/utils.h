@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "defines.h"
+#include "metrics.h"
 
 using namespace std::chrono;
 
@@ -20,9 +21,15 @@ using namespace std::chrono;
 // # of bytes in output of hash h: h(x)^a
 #define HASH_1_SIZE 32
 
-// # of bytes in output of hash g: g(h(x)^a)
+// default # of bytes in output of hash g: g(h(x)^a)
 #define HASH_3_SIZE 10
 
+// false positive rate the entry size calculator aims under by default
+#define FALSE_POSITIVE_RATE 1e-6
+
+// # of elements hashed together by the batch hashing functions
+#define HASH_BATCH_SIZE 256
+
 namespace unbalanced_psi {
 
     /**
@@ -41,6 +48,12 @@ namespace unbalanced_psi {
         // number of threads to run at once
         int threads;
 
+        // number of bytes of each oprf output kept (see supported_entry_size)
+        u64 entry_size = HASH_3_SIZE;
+
+        // whether hashtables drop the bits of each entry implied by its bucket
+        bool compact = true;
+
         PSIParams(const PSIParams&) = default;
 
         // when not using a cuckoo table
@@ -54,6 +67,28 @@ namespace unbalanced_psi {
             hashtable_size(hsize), threads(th) { }
     };
 
+    /**
+     * whether the protocol can be run with entries of this many bytes (6, 8,
+     *  10 or 16, which keep the bucket hash and pir packing simple)
+     */
+    bool supported_entry_size(u64 entry_size);
+
+    /**
+     * upper bound on the probability that any of the client's elements outside
+     *  the intersection is reported in it, |X| * |Y| / 2^(8 * entry_size)
+     *
+     * @params <server_size> number of elements in the server's dataset
+     * @params <client_size> number of elements in the client's dataset
+     * @params <entry_size>  number of bytes of each oprf output kept
+     */
+    double false_positive_bound(u64 server_size, u64 client_size, u64 entry_size);
+
+    /**
+     * smallest supported entry size with a false positive bound under <rate>
+     *  (the largest supported size if none are)
+     */
+    u64 smallest_entry_size(u64 server_size, u64 client_size, double rate);
+
     /**
      * generate a mock dataset
      *
@@ -65,9 +100,9 @@ namespace unbalanced_psi {
     /**
      * generate two mock datasets for the server and client
      *
-     * @param <server_size> number of elements in the server's dataset
-     * @param <client_size> number of elements in the client's dataset
-     * @param <overlap>     _minimum_ number of elements shared between the two datasets
+     * @params <server_size> number of elements in the server's dataset
+     * @params <client_size> number of elements in the client's dataset
+     * @param <overlap>     exact number of elements shared between the two datasets
      * @return random vector of numbers
      */
     tuple<vector<INPUT_TYPE>,vector<INPUT_TYPE>> generate_datasets(int server_size, int client_size, int overlap);
@@ -143,6 +178,27 @@ namespace unbalanced_psi {
      */
     void hash_group_element(const Point& element, int length, u8* dest);
 
+    /**
+     * batch form of hash_to_group_element, which still hashes one element at
+     *  a time since apsi fuses the hash into its hash-to-curve constructor
+     *
+     * @params <inputs> set elements to hash
+     * @params <count> number of elements
+     * @params <dest> where to put the <count> group elements
+     */
+    void hash_to_group_elements(const INPUT_TYPE* inputs, u64 count, Point* dest);
+
+    /**
+     * batch form of hash_group_element, writing the hashes back to back and
+     *  computing several at once with blake2b_many
+     *
+     * @params <elements> group elements to hash
+     * @params <count> number of elements
+     * @params <length> length of each hash
+     * @params <dest> where to put the <count> * <length> bytes
+     */
+    void hash_group_elements(const Point* elements, u64 count, int length, u8* dest);
+
     /**
      * convert a Point into a hex string for debugging
      */
@@ -164,5 +220,6 @@ namespace unbalanced_psi {
             std::string message;
             std::string color;
             std::chrono::time_point<std::chrono::high_resolution_clock> start;
+            std::unique_ptr<PerfCounters> counters;
     };
 }